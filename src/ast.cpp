@@ -0,0 +1,159 @@
+#include <cassert>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "ast.h"
+
+
+using std::make_shared;
+using std::pair;
+using std::string;
+
+
+NodeId Ast::add_value(Value value) {
+    AstNode node{};
+    node.type = static_cast<TokenType>(value.type);
+    node.op = OpCode::COUNT;
+    node.nchildren = 0;
+    node.value = value;
+    this->nodes.push_back(node);
+    return static_cast<NodeId>(this->nodes.size() - 1);
+}
+
+NodeId Ast::add_variable(const string &name) {
+    auto inserted = this->var_slots.emplace(name, static_cast<uint32_t>(this->var_names.size()));
+    if (inserted.second) {
+        this->var_names.push_back(name);
+    }
+
+    AstNode node{};
+    node.type = TokenType::NAME;
+    node.op = OpCode::COUNT;
+    node.nchildren = 0;
+    node.slot = inserted.first->second;
+    node.value = Value::of_int(0);
+    this->nodes.push_back(node);
+    return static_cast<NodeId>(this->nodes.size() - 1);
+}
+
+NodeId Ast::add_operator(TokenType type) {
+    AstNode node{};
+    node.type = type;
+    node.op = OpCode::COUNT;
+    node.nchildren = 0;
+    node.value = Value::of_int(0);
+    this->nodes.push_back(node);
+    return static_cast<NodeId>(this->nodes.size() - 1);
+}
+
+void Ast::add_child(NodeId parent, NodeId child) {
+    AstNode &node = this->nodes[parent];
+    assert(node.nchildren < MAX_CHILDREN);
+    node.children[node.nchildren++] = child;
+    node.op = token_opcode(node.type, node.nchildren);
+}
+
+
+bool ast_equal(const Ast &ast1, NodeId id1, const Ast &ast2, NodeId id2) {
+    vector<pair<NodeId, NodeId>> pending = {{id1, id2}};
+    while (!pending.empty()) {
+        const AstNode &node1 = ast1[pending.back().first];
+        const AstNode &node2 = ast2[pending.back().second];
+        pending.pop_back();
+        if (node1.type != node2.type || node1.nchildren != node2.nchildren) {
+            return false;
+        }
+        if (node1.type == TokenType::NAME) {
+            if (ast1.var_names[node1.slot] != ast2.var_names[node2.slot]) {
+                return false;
+            }
+            continue;
+        }
+        if (node1.nchildren == 0 && !(node1.value == node2.value)) {
+            return false;
+        }
+        for (size_t i = 0; i < node1.nchildren; i++) {
+            pending.emplace_back(node1.children[i], node2.children[i]);
+        }
+    }
+    return true;
+}
+
+bool operator==(const Ast &ast1, const Ast &ast2) {
+    if (ast1.empty() || ast2.empty()) {
+        return ast1.empty() && ast2.empty();
+    }
+    return ast_equal(ast1, ast1.root, ast2, ast2.root);
+}
+
+bool operator!=(const Ast &ast1, const Ast &ast2) {
+    return !(ast1 == ast2);
+}
+
+
+static Token::Ptr node_token(const Ast &ast, const AstNode &node) {
+    if (node.type == TokenType::INT) {
+        return make_shared<TokenInt>(node.value.ival);
+    } else if (node.type == TokenType::FLOAT) {
+        return make_shared<TokenFloat>(node.value.fval);
+    } else if (node.type == TokenType::BIG) {
+        return make_shared<TokenBig>(node.value.big_value());
+    } else if (node.type == TokenType::NAME) {
+        return make_shared<TokenName>(ast.var_names[node.slot]);
+    } else {
+        return make_shared<Token>(node.type);
+    }
+}
+
+
+Node::Ptr ast_to_node(const Ast &ast, NodeId id) {
+    Node::Ptr ans = make_shared<Node>(node_token(ast, ast[id]));
+    // nodes are created before their children, which are then filled in
+    vector<pair<NodeId, Node *>> pending = {{id, ans.get()}};
+    while (!pending.empty()) {
+        const AstNode &node = ast[pending.back().first];
+        Node *dst = pending.back().second;
+        pending.pop_back();
+        for (size_t i = 0; i < node.nchildren; i++) {
+            const AstNode &child = ast[node.children[i]];
+            dst->children.push_back(make_shared<Node>(node_token(ast, child)));
+            pending.emplace_back(node.children[i], dst->children.back().get());
+        }
+    }
+    return ans;
+}
+
+Node::Ptr ast_to_node(const Ast &ast) {
+    assert(!ast.empty());
+    return ast_to_node(ast, ast.root);
+}
+
+
+string repr_ast(const Ast &ast, NodeId id, unsigned int indent) {
+    string ans;
+    vector<pair<NodeId, unsigned int>> pending = {{id, indent}};
+    while (!pending.empty()) {
+        const AstNode &node = ast[pending.back().first];
+        unsigned int level = pending.back().second;
+        pending.pop_back();
+
+        ans.append(level * 4, ' ');
+        if (node.type == TokenType::INT) {
+            ans += "Int " + to_string(node.value.ival);
+        } else if (node.type == TokenType::FLOAT) {
+            ans += "Float " + to_string(node.value.fval);
+        } else if (node.type == TokenType::BIG) {
+            ans += "Big " + node.value.big_value().to_string();
+        } else if (node.type == TokenType::NAME) {
+            ans += "Name " + ast.var_names[node.slot];
+        } else {
+            ans += "Token:" + string(1, static_cast<char>(node.type)) + " ";
+        }
+        ans += "\n";
+        for (size_t i = node.nchildren; i-- > 0;) {
+            pending.emplace_back(node.children[i], level + 1);
+        }
+    }
+    return ans;
+}
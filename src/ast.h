@@ -0,0 +1,144 @@
+#ifndef CALCXX_AST_H
+#define CALCXX_AST_H
+
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "node.h"
+#include "operators.h"
+#include "tokens.h"
+#include "utils.hpp"
+#include "value.h"
+
+
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+
+typedef uint32_t NodeId;
+static const NodeId NO_NODE = UINT32_MAX;
+
+
+struct AstNode {
+    TokenType type;     // INT, FLOAT, BIG, NAME or the operator token
+    OpCode op;          // COUNT for leaves and unsupported operators
+    uint8_t nchildren;
+    union {
+        NodeId children[2];
+        uint32_t slot;  // for NAME, index into Ast::var_names
+    };
+    Value value;        // for INT, FLOAT and BIG
+
+    bool is_value() const {
+        return this->nchildren == 0
+            && (this->type == TokenType::INT || this->type == TokenType::FLOAT
+                || this->type == TokenType::BIG);
+    }
+};
+
+
+/*
+ * An AST stored as a flat array of nodes, children are referenced by index.
+ * After intern_ast() a node can be the child of several parents, the nodes
+ * then form a DAG that the functions below still see as the expanded tree.
+ * Nodes are never freed one by one, clear() drops them all and keeps the memory.
+ * Variables are numbered in order of first appearance, evaluation reads
+ * the value of a variable from a flat array indexed by its slot.
+ */
+class Ast {
+public:
+    static const size_t MAX_CHILDREN = 2;
+
+    vector<AstNode> nodes;
+    NodeId root = NO_NODE;
+    vector<string> var_names;                   // indexed by slot
+    unordered_map<string, uint32_t> var_slots;
+
+    NodeId add_value(Value value);
+    NodeId add_variable(const string &name);
+    NodeId add_operator(TokenType type);
+    // also updates the OpCode of parent for the new number of children
+    void add_child(NodeId parent, NodeId child);
+
+    const AstNode &operator[](NodeId id) const {
+        return this->nodes[id];
+    }
+
+    bool empty() const {
+        return this->root == NO_NODE;
+    }
+
+    void clear() {
+        this->nodes.clear();
+        this->root = NO_NODE;
+        this->var_names.clear();
+        this->var_slots.clear();
+    }
+};
+
+
+// functions recursing on the tree switch to walk_ast() below this depth,
+// the native stack is faster for the usual shallow expressions
+static const size_t MAX_AST_RECURSION = 100;
+
+
+// a node waiting in walk_ast(), expanded once its children are on the stack
+struct AstWalkItem {
+    NodeId id;
+    bool expanded;
+};
+
+
+/*
+ * Visits the subtree of id without recursion, so deep trees only cost heap
+ * memory. enter(id, node) is called on operator nodes before their children
+ * are visited and returns false to skip them, leave(id, node) on every node
+ * after its children, in the order of a recursive post-order walk. stack is
+ * scratch space, reusing it between walks saves allocations.
+ */
+template<class Enter, class Leave>
+void walk_ast(const Ast &ast, NodeId id, vector<AstWalkItem> &stack, Enter enter, Leave leave) {
+    stack.clear();
+    stack.push_back({id, false});
+    while (!stack.empty()) {
+        AstWalkItem item = stack.back();
+        const AstNode &node = ast[item.id];
+        if (item.expanded || node.nchildren == 0) {
+            stack.pop_back();
+            leave(item.id, node);
+            continue;
+        }
+        stack.back().expanded = true;
+        if (!enter(item.id, node)) {
+            continue;
+        }
+        for (size_t i = node.nchildren; i-- > 0;) {
+            stack.push_back({node.children[i], false});
+        }
+    }
+}
+
+
+bool ast_equal(const Ast &ast1, NodeId id1, const Ast &ast2, NodeId id2);
+bool operator==(const Ast &ast1, const Ast &ast2);
+bool operator!=(const Ast &ast1, const Ast &ast2);
+
+// builds the equivalent pointer based Node tree, for tests and debugging
+Node::Ptr ast_to_node(const Ast &ast, NodeId id);
+Node::Ptr ast_to_node(const Ast &ast);
+
+
+// same format as repr_node()
+string repr_ast(const Ast &ast, NodeId id, unsigned int indent = 0);
+
+
+REPR(Ast) {
+    return value.empty() ? string() : repr_ast(value, value.root);
+}
+
+
+#endif //CALCXX_AST_H
@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "batch.h"
+#include "spsc_ring.h"
+
+
+using std::condition_variable;
+using std::count;
+using std::deque;
+using std::lock_guard;
+using std::memchr;
+using std::min;
+using std::move;
+using std::mutex;
+using std::queue;
+using std::string;
+using std::thread;
+using std::to_string;
+using std::unique_lock;
+using std::unique_ptr;
+using std::vector;
+
+
+static const size_t BLOCK_SIZE = 1 << 20;
+// processed parts of a mapped file are dropped from memory in steps of this size
+static const size_t RELEASE_SIZE = 4 << 20;
+// input is handed to worker threads in chunks of about this size
+static const size_t CHUNK_SIZE = 256 << 10;
+// chunks being evaluated or waiting to be written, per thread
+static const size_t CHUNKS_PER_THREAD = 4;
+// blocks between two stages of a pipelined batch
+static const size_t PIPELINE_DEPTH = 4;
+
+
+void OutputBuffer::flush() {
+    if (!this->buf.empty()) {
+        fwrite(this->buf.data(), 1, this->buf.size(), this->file);
+        fflush(this->file);
+        this->buf.clear();
+    }
+}
+
+
+void append_line_result(string &out, string &err, const LineResult &result, size_t lineno) {
+    switch (result.status) {
+    case LineStatus::ok:
+        out += repr(result.value);
+        out += '\n';
+        break;
+    case LineStatus::error:
+        err += "line " + to_string(lineno) + ", col " + to_string(result.start.rowno + 1) + ": ";
+        err += result.error;
+        err += '\n';
+        break;
+    case LineStatus::blank:
+        break;
+    }
+}
+
+
+// call func on each line of data, a last line without newline included
+template<class Func>
+static void for_each_line(string_view data, Func func) {
+    const char *p = data.data();
+    const char *const end = p + data.size();
+    const char *newline;
+    while ((newline = (const char *)memchr(p, '\n', end - p))) {
+        func(string_view(p, newline - p));
+        p = newline + 1;
+    }
+    if (p < end) {
+        func(string_view(p, end - p));
+    }
+}
+
+
+// evaluates lines one by one, numbering them from 1
+class LineProcessor {
+public:
+    size_t failed = 0;
+
+    LineProcessor(EvalMode mode, size_t cache_size, FILE *out, FILE *err)
+        : calc(mode, cache_size), out_buf(out), err_buf(err)
+    {}
+
+    void process(string_view line) {
+        LineResult result = this->calc.eval_line(line);
+        this->out_str.clear();
+        this->err_str.clear();
+        append_line_result(this->out_str, this->err_str, result, ++this->lineno);
+        this->out_buf.write(this->out_str);
+        if (result.status == LineStatus::error) {
+            this->err_buf.write(this->err_str);
+            this->failed++;
+        }
+    }
+
+private:
+    Calculator calc;
+    OutputBuffer out_buf;
+    OutputBuffer err_buf;
+    string out_str;
+    string err_str;
+    size_t lineno = 0;
+};
+
+
+// whole lines of input, evaluated by one worker
+struct Chunk {
+    string storage;         // owns the data unless it is mapped
+    string_view data;
+    size_t lineno = 0;      // number of lines before the chunk
+    size_t end_offset = 0;  // offset in the mapped file after the chunk
+    string out;
+    string err;
+    size_t failed = 0;
+    bool done = false;
+};
+
+
+/*
+ * Evaluates chunks on a pool of workers, each with its own Calculator,
+ * and writes the results in the order the chunks were submitted.
+ */
+class ParallelBatch {
+public:
+    ParallelBatch(
+        EvalMode mode, size_t cache_size, size_t threads, FILE *out, FILE *err,
+        MappedFile *file = nullptr)
+        : out_buf(out), err_buf(err), file(file), max_chunks(threads * CHUNKS_PER_THREAD)
+    {
+        for (size_t i = 0; i < threads; i++) {
+            this->workers.emplace_back(&ParallelBatch::work, this, mode, cache_size);
+        }
+    }
+
+    ~ParallelBatch() {
+        {
+            lock_guard<mutex> lock(this->mtx);
+            this->stopped = true;
+        }
+        this->work_cond.notify_all();
+        for (thread &worker : this->workers) {
+            worker.join();
+        }
+    }
+
+    // chunk.data must stay valid until the chunk is written
+    void submit(unique_ptr<Chunk> chunk) {
+        unique_lock<mutex> lock(this->mtx);
+        this->write_done(lock);
+        while (this->chunks.size() >= this->max_chunks) {
+            this->done_cond.wait(lock);
+            this->write_done(lock);
+        }
+        this->todo.push(chunk.get());
+        this->chunks.push_back(move(chunk));
+        this->work_cond.notify_one();
+    }
+
+    // wait for all chunks and write them, returns the number of failed lines
+    size_t finish() {
+        unique_lock<mutex> lock(this->mtx);
+        this->write_done(lock);
+        while (!this->chunks.empty()) {
+            this->done_cond.wait(lock);
+            this->write_done(lock);
+        }
+        return this->failed;
+    }
+
+private:
+    OutputBuffer out_buf;
+    OutputBuffer err_buf;
+    MappedFile *file;
+    size_t max_chunks;
+    size_t failed = 0;
+
+    mutex mtx;
+    condition_variable work_cond;
+    condition_variable done_cond;
+    deque<unique_ptr<Chunk>> chunks;    // in submission order
+    queue<Chunk *> todo;
+    bool stopped = false;
+    vector<thread> workers;
+
+    void work(EvalMode mode, size_t cache_size) {
+        Calculator calc(mode, cache_size);
+        while (true) {
+            Chunk *chunk;
+            {
+                unique_lock<mutex> lock(this->mtx);
+                while (this->todo.empty() && !this->stopped) {
+                    this->work_cond.wait(lock);
+                }
+                if (this->todo.empty()) {
+                    return;
+                }
+                chunk = this->todo.front();
+                this->todo.pop();
+            }
+
+            size_t lineno = chunk->lineno;
+            for_each_line(chunk->data, [&](string_view line) {
+                LineResult result = calc.eval_line(line);
+                append_line_result(chunk->out, chunk->err, result, ++lineno);
+                if (result.status == LineStatus::error) {
+                    chunk->failed++;
+                }
+            });
+
+            lock_guard<mutex> lock(this->mtx);
+            chunk->done = true;
+            this->done_cond.notify_one();
+        }
+    }
+
+    // write finished chunks at the front, the lock is released while writing
+    void write_done(unique_lock<mutex> &lock) {
+        while (!this->chunks.empty() && this->chunks.front()->done) {
+            unique_ptr<Chunk> chunk = move(this->chunks.front());
+            this->chunks.pop_front();
+            lock.unlock();
+            this->out_buf.write(chunk->out);
+            this->err_buf.write(chunk->err);
+            this->failed += chunk->failed;
+            if (this->file) {
+                this->file->release_before(chunk->end_offset);
+            }
+            lock.lock();
+        }
+    }
+};
+
+
+// read up to read_size bytes after the unfinished line in pending into block,
+// the unfinished last line goes back to pending, returns the number of bytes read
+static size_t read_lines(FILE *input, string &pending, string &block, size_t read_size) {
+    block.clear();
+    block.swap(pending);
+    size_t size = block.size();
+    block.resize(size + read_size);
+    size_t nread = fread(&block[size], 1, read_size, input);
+    block.resize(size + nread);
+    if (nread > 0) {
+        size_t last_newline = block.rfind('\n');
+        size_t keep = last_newline == string::npos ? 0 : last_newline + 1;
+        pending.assign(block, keep, string::npos);
+        block.resize(keep);
+    }
+    return nread;
+}
+
+
+// the output of one block of input
+struct BlockResult {
+    string out;
+    string err;
+};
+
+
+/*
+ * A single threaded batch split into stages: a reader thread fills blocks of
+ * whole lines, the calling thread evaluates them and a writer thread writes
+ * the results, handed over through SpscRings. Evaluation goes on while the
+ * other stages wait for I/O.
+ */
+static size_t run_pipelined(
+    EvalMode mode, FILE *input, FILE *out, FILE *err, size_t cache_size)
+{
+    SpscRing<string> blocks(PIPELINE_DEPTH);
+    SpscRing<BlockResult> results(PIPELINE_DEPTH);
+
+    thread reader([&]() {
+        string pending, block;
+        while (true) {
+            size_t nread = read_lines(input, pending, block, BLOCK_SIZE);
+            if (!block.empty()) {
+                blocks.push(move(block));
+            }
+            if (nread == 0) {
+                break;
+            }
+        }
+        blocks.close();
+    });
+    thread writer([&]() {
+        OutputBuffer out_buf(out);
+        OutputBuffer err_buf(err);
+        BlockResult result;
+        while (results.pop(result)) {
+            out_buf.write(result.out);
+            err_buf.write(result.err);
+        }
+    });
+
+    Calculator calc(mode, cache_size);
+    size_t lineno = 0;
+    size_t failed = 0;
+    string block;
+    while (blocks.pop(block)) {
+        BlockResult result;
+        for_each_line(block, [&](string_view line) {
+            LineResult line_result = calc.eval_line(line);
+            append_line_result(result.out, result.err, line_result, ++lineno);
+            if (line_result.status == LineStatus::error) {
+                failed++;
+            }
+        });
+        results.push(move(result));
+    }
+    results.close();
+
+    reader.join();
+    writer.join();
+    return failed;
+}
+
+
+size_t run_batch(
+    EvalMode mode, FILE *input, FILE *out, FILE *err, size_t threads, size_t cache_size)
+{
+    if (threads <= 1) {
+        return run_pipelined(mode, input, out, err, cache_size);
+    }
+
+    ParallelBatch batch(mode, cache_size, threads, out, err);
+    size_t lineno = 0;
+    string pending;
+    while (true) {
+        unique_ptr<Chunk> chunk(new Chunk);
+        size_t nread = read_lines(input, pending, chunk->storage, CHUNK_SIZE);
+        chunk->data = chunk->storage;
+        chunk->lineno = lineno;
+        lineno += count(chunk->data.begin(), chunk->data.end(), '\n');
+        if (!chunk->data.empty()) {
+            batch.submit(move(chunk));
+        }
+        if (nread == 0) {
+            break;
+        }
+    }
+    return batch.finish();
+}
+
+
+size_t run_batch(
+    EvalMode mode, MappedFile &file, FILE *out, FILE *err, size_t threads, size_t cache_size)
+{
+    string_view data = file.data();
+
+    if (threads > 1) {
+        ParallelBatch batch(mode, cache_size, threads, out, err, &file);
+        size_t lineno = 0;
+        size_t start = 0;
+        while (start < data.size()) {
+            size_t end = data.find('\n', min(start + CHUNK_SIZE, data.size()) - 1);
+            end = end == string_view::npos ? data.size() : end + 1;
+
+            unique_ptr<Chunk> chunk(new Chunk);
+            chunk->data = data.substr(start, end - start);
+            chunk->lineno = lineno;
+            chunk->end_offset = end;
+            lineno += count(chunk->data.begin(), chunk->data.end(), '\n');
+            batch.submit(move(chunk));
+            start = end;
+        }
+        return batch.finish();
+    }
+
+    LineProcessor proc(mode, cache_size, out, err);
+    size_t released = 0;
+    size_t start = 0;
+    while (start < data.size()) {
+        size_t newline = data.find('\n', start);
+        if (newline == string_view::npos) {
+            newline = data.size();
+        }
+        proc.process(data.substr(start, newline - start));
+        start = newline + 1;
+
+        if (start - released >= RELEASE_SIZE) {
+            file.release_before(start);
+            released = start;
+        }
+    }
+    return proc.failed;
+}
+
+
+size_t run_batch_file(
+    EvalMode mode, const string &path, FILE *out, FILE *err, size_t threads, size_t cache_size)
+{
+    unique_ptr<MappedFile> file;
+    try {
+        file.reset(new MappedFile(path));
+    } catch (const IOError &) {
+        // not mappable, e.g. a pipe, read it as a stream
+        FILE *input = fopen(path.data(), "rb");
+        if (!input) {
+            throw;
+        }
+        size_t failed = run_batch(mode, input, out, err, threads, cache_size);
+        fclose(input);
+        return failed;
+    }
+    return run_batch(mode, *file, out, err, threads, cache_size);
+}
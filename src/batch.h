@@ -0,0 +1,72 @@
+#ifndef CALCXX_BATCH_H
+#define CALCXX_BATCH_H
+
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "calculator.h"
+#include "mapped_file.h"
+
+
+using std::string;
+using std::string_view;
+
+
+/*
+ * Collects output in memory and writes it in large chunks.
+ */
+class OutputBuffer {
+public:
+    static const size_t FLUSH_SIZE = 1 << 20;
+
+    explicit OutputBuffer(FILE *file) : file(file) {}
+    ~OutputBuffer() {
+        this->flush();
+    }
+
+    void write(string_view str) {
+        this->buf.append(str.data(), str.size());
+        if (this->buf.size() >= FLUSH_SIZE) {
+            this->flush();
+        }
+    }
+
+    void flush();
+
+private:
+    FILE *file;
+    string buf;
+};
+
+
+// append the result to out or the error to err as batch mode prints them, lineno counts from 1
+void append_line_result(string &out, string &err, const LineResult &result, size_t lineno);
+
+
+/*
+ * Evaluate every line of input without prompts. Results go to out one per line,
+ * errors go to err with their line and column. Blank lines are skipped.
+ * Returns the number of lines that failed.
+ *
+ * With one thread, reading and writing run on threads of their own while the
+ * calling thread evaluates. With more than one thread, chunks of lines are
+ * evaluated in parallel and the output is the same as with one thread.
+ * cache_size is the size of the ResultCache of each thread's Calculator,
+ * 0 for none.
+ */
+size_t run_batch(
+    EvalMode mode, FILE *input, FILE *out, FILE *err, size_t threads = 1, size_t cache_size = 0);
+// evaluate directly from the mapped bytes, dropping processed pages along the way
+size_t run_batch(
+    EvalMode mode, MappedFile &file, FILE *out, FILE *err,
+    size_t threads = 1, size_t cache_size = 0);
+// map the file at path if possible, read it as a stream otherwise, throws IOError
+size_t run_batch_file(
+    EvalMode mode, const string &path, FILE *out, FILE *err,
+    size_t threads = 1, size_t cache_size = 0);
+
+
+#endif //CALCXX_BATCH_H
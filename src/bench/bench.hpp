@@ -0,0 +1,68 @@
+#ifndef CALCXX_BENCH_HPP
+#define CALCXX_BENCH_HPP
+
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+
+using std::string;
+
+
+// keep the compiler from optimizing away a computed value
+template<class T>
+inline void do_not_optimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+
+// run func() iters times, return the average nanoseconds per call
+template<class Func>
+double bench_ns(size_t iters, Func func) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iters; i++) {
+        func();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::nano> elapsed = stop - start;
+    return elapsed.count() / iters;
+}
+
+
+/*
+ * With BENCH_FORMAT=tsv in the environment, results are printed as
+ * "name<TAB>value<TAB>unit" lines instead of aligned columns, so that the
+ * runs of two versions can be joined on the name and compared:
+ *
+ *   BENCH_FORMAT=tsv ./bench_suite > new.tsv
+ *   join -t $'\t' old.tsv new.tsv
+ */
+inline bool bench_tsv() {
+    static const bool tsv = getenv("BENCH_FORMAT") && string(getenv("BENCH_FORMAT")) == "tsv";
+    return tsv;
+}
+
+
+// unit is what ns is spent on, e.g. "expr" for nanoseconds per expression
+inline void bench_report(const string &name, double ns, const char *unit) {
+    if (bench_tsv()) {
+        printf("%s\t%.1f\tns/%s\n", name.data(), ns, unit);
+    } else {
+        printf("%-40s %12.1f ns/%s\n", name.data(), ns, unit);
+    }
+}
+
+
+inline void bench_report(const string &name, double ns) {
+    if (bench_tsv()) {
+        printf("%s\t%.1f\tns\n", name.data(), ns);
+    } else {
+        printf("%-40s %12.1f ns\n", name.data(), ns);
+    }
+}
+
+
+#endif //CALCXX_BENCH_HPP
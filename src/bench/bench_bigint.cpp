@@ -0,0 +1,46 @@
+/*
+ * BigInt multiplication and decimal output for numbers of 100 to 10000
+ * digits, around and well above the schoolbook and Karatsuba cutoff.
+ */
+
+#include <random>
+#include <string>
+
+#include "bench.hpp"
+#include "../bigint.h"
+
+
+using std::mt19937_64;
+using std::string;
+using std::to_string;
+
+
+static BigInt random_big(mt19937_64 &rng, size_t digits) {
+    string text(1, char('1' + rng() % 9));
+    while (text.size() < digits) {
+        text += char('0' + rng() % 10);
+    }
+    return BigInt::from_digits(text);
+}
+
+
+int main() {
+    mt19937_64 rng(1);
+    for (size_t digits : {100, 1000, 10000}) {
+        const size_t iters = 10000000 / (digits * digits / 100 + 1000);
+        BigInt a = random_big(rng, digits);
+        BigInt b = random_big(rng, digits);
+        string text = (a * b).to_string();
+        string n = to_string(digits);
+
+        bench_report("mult/" + n, bench_ns(iters, [&]() {
+            do_not_optimize(a * b);
+        }));
+        bench_report("to_string/" + n, bench_ns(iters, [&]() {
+            do_not_optimize(a.to_string());
+        }));
+        bench_report("from_digits/" + n, bench_ns(iters, [&]() {
+            do_not_optimize(BigInt::from_digits(text));
+        }));
+    }
+}
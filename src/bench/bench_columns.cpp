@@ -0,0 +1,63 @@
+/*
+ * One formula over a million rows: ColumnFormula (batch kernels per block)
+ * against a Formula evaluated row by row. Reports nanoseconds per row.
+ */
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench.hpp"
+#include "../columns.h"
+#include "../formula.h"
+
+
+using std::pair;
+using std::string;
+using std::vector;
+
+
+int main() {
+    const size_t rows = 1 << 20;
+    vector<double> floats(rows);
+    vector<int64_t> ints(rows);
+    for (size_t i = 0; i < rows; i++) {
+        floats[i] = i * 0.25;
+        ints[i] = int64_t(i % 1000);
+    }
+    vector<Column> columns = {Column::of_floats(floats.data()), Column::of_ints(ints.data())};
+    vector<Value> out(rows);
+
+    vector<pair<string, string>> workloads = {
+        {"float", "$0 * 1.5 + $0 / 4"},
+        {"int", "$1 * 3 - $1 + 7"},
+        {"mixed", "($0 + $1) * 2 - $1 / 8.0"},
+    };
+
+    for (const auto &workload : workloads) {
+        const string &name = workload.first;
+        ColumnFormula cf(workload.second);
+        bench_report("columns/" + name + "/batch", bench_ns(5, [&]() {
+            cf.eval(columns, rows, out.data());
+            do_not_optimize(out[rows - 1]);
+        }) / rows);
+
+        const Formula &f = cf.get_formula();
+        VM vm;
+        vector<Value> vars(f.var_count());
+        vector<bool> is_float;
+        for (const string &var : f.var_names()) {
+            is_float.push_back(var == "$0");
+        }
+        bench_report("columns/" + name + "/row", bench_ns(5, [&]() {
+            for (size_t i = 0; i < rows; i++) {
+                for (size_t slot = 0; slot < vars.size(); slot++) {
+                    vars[slot] = is_float[slot] ? Value::of_float(floats[i]) : Value::of_int(ints[i]);
+                }
+                out[i] = f.eval(vars, vm);
+            }
+            do_not_optimize(out[rows - 1]);
+        }) / rows);
+    }
+}
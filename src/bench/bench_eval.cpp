@@ -0,0 +1,108 @@
+/*
+ * Compares the three evaluators on pre-tokenized input:
+ * TokensEvaluator (shunting-yard), eval_ast (AST walk) and VM (bytecode).
+ * Only evaluation is timed, parsing and compiling happen once.
+ * simplify times the simplify_ast() pass, ast_simplified evaluates its result.
+ */
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench.hpp"
+#include "../bytecode.h"
+#include "../eval.h"
+#include "../eval_ast.h"
+#include "../ast.h"
+#include "../parser.h"
+#include "../simplify.h"
+#include "../tokenizer.h"
+#include "../tokens.h"
+
+
+using std::pair;
+using std::string;
+using std::to_string;
+using std::vector;
+
+
+static vector<Token::Ptr> tokenize_string(const string &str) {
+    Tokenizer tokenizer;
+    for (size_t i = 0; i <= str.size(); i++) {
+        tokenizer.feed(str[i]);
+    }
+
+    vector<Token::Ptr> tokens;
+    for (Token::Ptr tok = tokenizer.pop(); tok; tok = tokenizer.pop()) {
+        tokens.push_back(tok);
+    }
+    return tokens;
+}
+
+
+static string flat_sum(int terms) {
+    string ans = "1";
+    for (int i = 2; i <= terms; i++) {
+        ans += " + " + to_string(i) + " * 2";
+    }
+    return ans;
+}
+
+
+static string nested(int depth) {
+    string ans = "1";
+    for (int i = 0; i < depth; i++) {
+        ans = "(" + ans + " + " + to_string(i) + ".5) / 2";
+    }
+    return ans;
+}
+
+
+int main() {
+    vector<pair<string, string>> workloads = {
+        {"short", "1 + 2 * 3 - 4 / 2"},
+        {"flat_sum_100", flat_sum(100)},
+        {"nested_50", nested(50)},
+    };
+
+    for (const auto &workload : workloads) {
+        const string &name = workload.first;
+        vector<Token::Ptr> tokens = tokenize_string(workload.second);
+        size_t iters = 2000000 / tokens.size();
+
+        Parser parser;
+        for (const Token::Ptr &tok : tokens) {
+            parser.feed(tok);
+        }
+        const Ast &ast = parser.get_result();
+        Program prog = compile_ast(ast);
+
+        TokensEvaluator calc;
+        bench_report(name + "/tokens", bench_ns(iters, [&]() {
+            calc.reset();
+            for (const Token::Ptr &tok : tokens) {
+                calc.feed(tok);
+            }
+            do_not_optimize(calc.get_result());
+        }));
+
+        bench_report(name + "/ast", bench_ns(iters, [&]() {
+            do_not_optimize(eval_ast(ast));
+        }));
+
+        VM vm;
+        bench_report(name + "/bytecode", bench_ns(iters, [&]() {
+            do_not_optimize(vm.run(prog));
+        }));
+
+        Ast simplified;
+        bench_report(name + "/simplify", bench_ns(iters, [&]() {
+            simplify_ast(ast, simplified);
+            do_not_optimize(simplified.root);
+        }));
+        bench_report(name + "/ast_simplified", bench_ns(iters, [&]() {
+            do_not_optimize(eval_ast(simplified));
+        }));
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * Evaluating one formula with changing inputs: a Formula compiled once and
+ * bound to new variable values, against re-parsing the expression text with
+ * the values substituted, which is what callers had to do without variables.
+ * The shared/... benches run a formula repeating one subexpression in every
+ * term, with the repeats computed once (Formula) or each time (the program
+ * of the tree).
+ */
+
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "../calculator.h"
+#include "../formula.h"
+#include "../parser.h"
+#include "../simplify.h"
+#include "../tokenizer.h"
+
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+
+int main() {
+    const size_t iters = 1000000;
+
+    Formula f("price * (1 + rate) - fee / qty + 2 * 3");
+    vector<Value> vars(f.var_count());
+    size_t price = f.slot("price");
+    size_t rate = f.slot("rate");
+    size_t fee = f.slot("fee");
+    size_t qty = f.slot("qty");
+    VM vm;
+    size_t i = 0;
+    bench_report("formula/bind_eval", bench_ns(iters, [&]() {
+        vars[price] = Value::of_int(int64_t(i % 1000));
+        vars[rate] = Value::of_float(0.25);
+        vars[fee] = Value::of_int(3);
+        vars[qty] = Value::of_int(int64_t(i % 7 + 1));
+        do_not_optimize(f.eval(vars, vm));
+        i++;
+    }));
+
+    Calculator calc(EvalMode::bytecode);
+    i = 0;
+    bench_report("formula/reparse", bench_ns(iters / 10, [&]() {
+        string text = to_string(i % 1000) + " * (1 + 0.25) - 3 / " + to_string(i % 7 + 1)
+            + " + 2 * 3";
+        do_not_optimize(calc.eval_line(text).value);
+        i++;
+    }));
+
+    string text;
+    for (int k = 1; k <= 8; k++) {
+        text += (k > 1 ? " + " : "") + string("(a * b + c / d) * x") + to_string(k);
+    }
+    Formula shared(text);
+    vector<Token::Ptr> tokens;
+    tokenize(text, tokens);
+    Parser parser;
+    for (const Token::Ptr &tok : tokens) {
+        parser.feed(tok);
+    }
+    Ast tree;
+    simplify_ast(parser.get_result(), tree);
+    Program tree_prog = compile_ast(tree);
+
+    vector<Value> shared_vars(shared.var_count(), Value::of_float(1.5));
+    bench_report("shared/dag", bench_ns(iters, [&]() {
+        do_not_optimize(shared.eval(shared_vars, vm));
+    }));
+    bench_report("shared/tree", bench_ns(iters, [&]() {
+        do_not_optimize(vm.run(tree_prog, shared_vars.data()));
+    }));
+}
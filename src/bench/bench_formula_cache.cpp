@@ -0,0 +1,60 @@
+/*
+ * Getting a Formula by its text from a FormulaCache, against compiling it
+ * again, for a pool of 100 formulas of the same shape.
+ */
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "../formula_cache.h"
+
+
+using std::max;
+using std::string;
+using std::thread;
+using std::to_string;
+using std::vector;
+
+
+int main() {
+    const size_t iters = 1000000;
+    vector<string> texts;
+    for (int i = 0; i < 100; i++) {
+        texts.push_back("price * (1 + rate) - fee / qty + " + to_string(i));
+    }
+    vector<Value> vars = {Value::of_int(100), Value::of_float(0.25), Value::of_int(3), Value::of_int(7)};
+
+    size_t i = 0;
+    VM vm;
+    bench_report("formula_cache/compile_eval", bench_ns(iters / 100, [&]() {
+        Formula f(texts[i++ % texts.size()]);
+        do_not_optimize(f.eval(vars, vm));
+    }));
+
+    FormulaCache cache(1024);
+    i = 0;
+    bench_report("formula_cache/get_eval", bench_ns(iters, [&]() {
+        do_not_optimize(cache.get(texts[i++ % texts.size()])->eval(vars, vm));
+    }));
+
+    // readers on every cpu share the cache, the time is per get in each thread
+    size_t nthreads = max(thread::hardware_concurrency(), 2u);
+    double ns = bench_ns(1, [&]() {
+        vector<thread> threads;
+        for (size_t t = 0; t < nthreads; t++) {
+            threads.emplace_back([&cache, &texts, &vars, t]() {
+                VM vm;
+                for (size_t k = 0; k < iters; k++) {
+                    do_not_optimize(cache.get(texts[(k + t) % texts.size()])->eval(vars, vm));
+                }
+            });
+        }
+        for (thread &th : threads) {
+            th.join();
+        }
+    });
+    bench_report("formula_cache/get_eval_" + to_string(nthreads) + "_threads", ns / iters);
+}
@@ -0,0 +1,58 @@
+/*
+ * One hot formula evaluated with each backend: walking the AST, the bytecode
+ * VM and native code from JitExpr. The formula is the same Formula's
+ * simplified AST, so every backend does the same arithmetic.
+ */
+
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "../eval_ast.h"
+#include "../formula.h"
+#include "../jit.h"
+
+
+using std::string;
+using std::vector;
+
+
+static void bench_formula(const string &name, const string &text, vector<Value> vars) {
+    const size_t iters = 1000000;
+    Formula f(text);
+    vector<ValueType> types;
+    for (const Value &v : vars) {
+        types.push_back(v.type);
+    }
+    JitExpr jit(f.get_ast(), types);
+    VM vm;
+
+    bench_report(name + "/eval_ast", bench_ns(iters, [&]() {
+        vars[0].fval += 1.0;
+        do_not_optimize(eval_ast(f.get_ast(), vars.data()));
+    }));
+    bench_report(name + "/vm", bench_ns(iters, [&]() {
+        vars[0].fval += 1.0;
+        do_not_optimize(f.eval(vars, vm));
+    }));
+    if (!jit.function()) {
+        fprintf(stderr, "%s: not compiled\n", name.data());
+        return;
+    }
+    bench_report(name + "/jit", bench_ns(iters, [&]() {
+        vars[0].fval += 1.0;
+        Value result;
+        do_not_optimize(jit.function()(vars.data(), &result));
+        do_not_optimize(result);
+    }));
+}
+
+
+int main() {
+    bench_formula("float", "price * (1 + rate) - fee / qty + 2 * 3", {
+        Value::of_float(100.0), Value::of_float(0.25), Value::of_float(3.0), Value::of_int(7),
+    });
+    bench_formula("poly", "((x * 3.5 - 2) * x + 0.5) * x - (x + 1) * (x - 1) / 4", {
+        Value::of_float(1.5),
+    });
+}
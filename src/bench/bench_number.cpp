@@ -0,0 +1,66 @@
+/*
+ * Number literal conversion: make_number() against strtod() on the same literals,
+ * and tokenize() on a literal-heavy line.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "../number.h"
+#include "../tokenizer.h"
+#include "../tokens.h"
+
+
+using std::mt19937_64;
+using std::string;
+using std::strtod;
+using std::vector;
+
+
+static vector<string> make_literals(size_t count, int precision) {
+    mt19937_64 rng(1);
+    vector<string> ans;
+    char buf[64];
+    for (size_t i = 0; i < count; i++) {
+        double value = (rng() % 1000000) / 997.0;
+        snprintf(buf, sizeof(buf), "%.*f", precision, value);
+        ans.push_back(buf);
+    }
+    return ans;
+}
+
+
+int main() {
+    const size_t count = 10000;
+    for (int precision : {2, 8, 17}) {
+        vector<string> literals = make_literals(count, precision);
+        string name = "digits_" + std::to_string(precision);
+
+        bench_report(name + "/make_number", bench_ns(100, [&]() {
+            for (const string &text : literals) {
+                do_not_optimize(make_number(text));
+            }
+        }) / count);
+
+        bench_report(name + "/strtod", bench_ns(100, [&]() {
+            for (const string &text : literals) {
+                do_not_optimize(strtod(text.data(), nullptr));
+            }
+        }) / count);
+
+        string line;
+        for (const string &text : literals) {
+            line += text + " ";
+        }
+        vector<Token::Ptr> tokens;
+        bench_report(name + "/tokenize", bench_ns(100, [&]() {
+            tokenize(line, tokens);
+            do_not_optimize(tokens.data());
+        }) / count);
+    }
+    return 0;
+}
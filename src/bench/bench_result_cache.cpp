@@ -0,0 +1,41 @@
+/*
+ * Calculator::eval_line on a duplicate-heavy workload: 100 distinct
+ * expressions with varying whitespace, with and without a ResultCache.
+ */
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "../calculator.h"
+
+
+using std::mt19937_64;
+using std::string;
+using std::to_string;
+using std::vector;
+
+
+int main() {
+    mt19937_64 rng(7);
+    vector<string> lines;
+    for (int i = 0; i < 1000; i++) {
+        string pad(rng() % 3, ' ');
+        int k = int(rng() % 100);
+        lines.push_back(
+            pad + "(" + to_string(k) + " + 2.5)" + pad + "* 3 - " + to_string(k) + " / 7 + (1 - 4) * 2");
+    }
+
+    const size_t iters = 500000;
+    for (EvalMode mode : {EvalMode::ast, EvalMode::bytecode}) {
+        string name = mode == EvalMode::ast ? "ast" : "bytecode";
+        for (size_t cache_size : {0, 1024}) {
+            Calculator calc(mode, cache_size);
+            size_t i = 0;
+            bench_report(name + "/cache_" + to_string(cache_size), bench_ns(iters, [&]() {
+                do_not_optimize(calc.eval_line(lines[i++ % lines.size()]));
+            }));
+        }
+    }
+}
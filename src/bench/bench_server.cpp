@@ -0,0 +1,216 @@
+/*
+ * Load generator for the --serve mode: clients on their own threads send
+ * batches of pipeline requests and wait for their responses, then the
+ * throughput and the latency percentiles of single requests are reported.
+ *
+ * Without --unix or --port a Server is started in this process on a
+ * temporary Unix socket.
+ *
+ *   bench_server [--unix PATH | --port N] [--clients C] [--requests N]
+ *                [--pipeline P] [--expr TEXT]
+ */
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "bench.hpp"
+#include "../server.h"
+
+
+using std::max;
+using std::memcpy;
+using std::min;
+using std::sort;
+using std::string;
+using std::thread;
+using std::to_string;
+using std::unique_ptr;
+using std::vector;
+using Clock = std::chrono::steady_clock;
+
+
+struct LoadOptions {
+    string unix_path;
+    int tcp_port = -1;
+    size_t clients = 8;
+    size_t requests = 20000;    // per client
+    size_t pipeline = 1;        // requests sent before reading responses
+    string expr = "(12 + 3.5) * 4 - 7 / 2";
+};
+
+
+static void die(const string &msg) {
+    fprintf(stderr, "bench_server: %s\n", msg.data());
+    exit(1);
+}
+
+
+static int connect_server(const LoadOptions &options) {
+    int fd;
+    int status;
+    if (options.tcp_port >= 0) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(uint16_t(options.tcp_port));
+        status = connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    } else {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, options.unix_path.data(),
+               min(options.unix_path.size(), sizeof(addr.sun_path) - 1));
+        status = connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    }
+    if (fd < 0 || status != 0) {
+        die("cannot connect: " + string(strerror(errno)));
+    }
+    return fd;
+}
+
+
+// sends the requests of one client, appends the latency of each to latencies
+static void run_client(const LoadOptions &options, vector<double> &latencies) {
+    int fd = connect_server(options);
+    string line = options.expr + "\n";
+    string batch;
+    vector<char> buf(1 << 16);
+
+    for (size_t done = 0; done < options.requests; ) {
+        size_t count = min(options.pipeline, options.requests - done);
+        batch.clear();
+        for (size_t i = 0; i < count; i++) {
+            batch += line;
+        }
+
+        Clock::time_point start = Clock::now();
+        for (size_t sent = 0; sent < batch.size(); ) {
+            ssize_t n = send(fd, batch.data() + sent, batch.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                die("send: " + string(strerror(errno)));
+            }
+            sent += size_t(n);
+        }
+        for (size_t received = 0; received < count; ) {
+            ssize_t n = read(fd, buf.data(), buf.size());
+            if (n <= 0) {
+                die("the server closed the connection");
+            }
+            Clock::time_point now = Clock::now();
+            std::chrono::duration<double, std::nano> elapsed = now - start;
+            for (ssize_t i = 0; i < n; i++) {
+                if (buf[size_t(i)] == '\n') {
+                    latencies.push_back(elapsed.count());
+                    received++;
+                }
+            }
+        }
+        done += count;
+    }
+    close(fd);
+}
+
+
+static double percentile(const vector<double> &sorted, double p) {
+    size_t index = size_t(p / 100 * double(sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+
+static size_t parse_count(const char *arg) {
+    char *end;
+    long value = strtol(arg, &end, 10);
+    if (*end != '\0' || value < 0) {
+        die(string("bad number: ") + arg);
+    }
+    return size_t(value);
+}
+
+
+int main(int argc, char *argv[]) {
+    LoadOptions options;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            die("missing value for " + arg);
+        }
+        const char *value = argv[++i];
+        if (arg == "--unix") {
+            options.unix_path = value;
+        } else if (arg == "--port") {
+            options.tcp_port = int(parse_count(value));
+        } else if (arg == "--clients") {
+            options.clients = max<size_t>(1, parse_count(value));
+        } else if (arg == "--requests") {
+            options.requests = max<size_t>(1, parse_count(value));
+        } else if (arg == "--pipeline") {
+            options.pipeline = max<size_t>(1, parse_count(value));
+        } else if (arg == "--expr") {
+            options.expr = value;
+        } else {
+            die("unknown option " + arg);
+        }
+    }
+
+    unique_ptr<Server> server;
+    thread server_thread;
+    if (options.unix_path.empty() && options.tcp_port < 0) {
+        ServerOptions server_options;
+        server_options.unix_path = "/tmp/calcxx_bench_" + to_string(getpid()) + ".sock";
+        server.reset(new Server(server_options));
+        server_thread = thread([&]() {
+            server->run();
+        });
+        options.unix_path = server_options.unix_path;
+    }
+
+    vector<vector<double>> latencies(options.clients);
+    vector<thread> clients;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < options.clients; i++) {
+        clients.emplace_back([&, i]() {
+            run_client(options, latencies[i]);
+        });
+    }
+    for (thread &client : clients) {
+        client.join();
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    if (server) {
+        server->stop();
+        server_thread.join();
+    }
+
+    vector<double> all;
+    for (const vector<double> &part : latencies) {
+        all.insert(all.end(), part.begin(), part.end());
+    }
+    sort(all.begin(), all.end());
+    fprintf(stderr, "%zu clients, %zu requests each, pipeline %zu: %.0f requests/s\n",
+            options.clients, options.requests, options.pipeline, double(all.size()) / elapsed.count());
+    // the inverse of the throughput, in the units of the latencies
+    bench_report("throughput", elapsed.count() * 1e9 / double(all.size()), "request");
+    bench_report("latency/p50", percentile(all, 50));
+    bench_report("latency/p90", percentile(all, 90));
+    bench_report("latency/p99", percentile(all, 99));
+    bench_report("latency/p99.9", percentile(all, 99.9));
+    bench_report("latency/max", all.back());
+}
@@ -0,0 +1,38 @@
+/*
+ * Calculator::eval_line on short lines with stats disabled and enabled,
+ * the difference is the cost of the phase timers and operator counts.
+ */
+
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "../calculator.h"
+#include "../stats.h"
+
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+
+int main() {
+    vector<string> lines;
+    for (int i = 0; i < 1000; i++) {
+        lines.push_back("(" + to_string(i) + " + 2.5) * 3 - " + to_string(i) + " / 7");
+    }
+
+    const size_t iters = 300000;
+    for (EvalMode mode : {EvalMode::ast, EvalMode::bytecode}) {
+        string name = mode == EvalMode::ast ? "ast" : "bytecode";
+        for (unsigned period : {0u, 1u, DEFAULT_SAMPLE_PERIOD}) {
+            enable_stats(period > 0, period);
+            Calculator calc(mode);
+            size_t i = 0;
+            string suffix = period == 0 ? "/off" : "/sample_" + to_string(period);
+            bench_report(name + suffix, bench_ns(iters, [&]() {
+                do_not_optimize(calc.eval_line(lines[i++ % lines.size()]));
+            }));
+        }
+    }
+}
@@ -0,0 +1,224 @@
+/*
+ * The stages of evaluating a line on synthetic workloads, each timed on its
+ * own: Tokenizer::feed(), Parser::feed(), then eval_node(), TokensEvaluator
+ * and the bytecode VM on the results of the previous stages. Every stage is
+ * reported in nanoseconds per expression and per token, END included.
+ *
+ * Run it with BENCH_FORMAT=tsv to compare versions, see bench.hpp.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "../ast.h"
+#include "../bytecode.h"
+#include "../eval.h"
+#include "../eval_ast.h"
+#include "../parser.h"
+#include "../tokenizer.h"
+#include "../tokens.h"
+
+
+using std::mt19937_64;
+using std::string;
+using std::to_string;
+using std::vector;
+
+
+struct Workload {
+    string name;
+    vector<string> exprs;
+};
+
+
+// a few operators over small ints, as typed at the prompt
+static Workload short_exprs(mt19937_64 &rng) {
+    const char *ops[] = {" + ", " - ", " * ", " / "};
+    Workload ans = {"short", {}};
+    for (int i = 0; i < 1000; i++) {
+        string expr = to_string(rng() % 100);
+        for (int j = 0; j < 3; j++) {
+            expr += ops[rng() % 4] + to_string(rng() % 100 + 1);
+        }
+        ans.exprs.push_back(expr);
+    }
+    return ans;
+}
+
+
+static Workload flat_sums(mt19937_64 &rng) {
+    Workload ans = {"flat_sum_1000", {}};
+    for (int i = 0; i < 4; i++) {
+        string expr = to_string(rng() % 1000);
+        for (int j = 1; j < 1000; j++) {
+            expr += " + " + to_string(rng() % 1000);
+        }
+        ans.exprs.push_back(expr);
+    }
+    return ans;
+}
+
+
+// every level opens a parenthesis, deeper than the recursion of eval_node()
+static Workload nested_parens(mt19937_64 &rng) {
+    Workload ans = {"nested_500", {}};
+    for (int i = 0; i < 4; i++) {
+        string expr = to_string(rng() % 10);
+        for (int j = 0; j < 500; j++) {
+            expr = "(" + expr + (j % 2 ? " * " : " - ") + to_string(rng() % 10 + 1) + ")";
+        }
+        ans.exprs.push_back(expr);
+    }
+    return ans;
+}
+
+
+// long literals with fractions and exponents, few operators per character
+static Workload literals(mt19937_64 &rng) {
+    Workload ans = {"literals", {}};
+    for (int i = 0; i < 100; i++) {
+        string expr;
+        for (int j = 0; j < 20; j++) {
+            expr += j == 0 ? "" : j % 2 ? " + " : " * ";
+            expr += to_string(rng() % 10000000) + "." + to_string(rng() % 1000000)
+                + "e" + (rng() % 2 ? "-" : "") + to_string(rng() % 10);
+        }
+        ans.exprs.push_back(expr);
+    }
+    return ans;
+}
+
+
+// ints and floats alternating, so that most operators convert
+static Workload mixed_types(mt19937_64 &rng) {
+    const char *ops[] = {" + ", " - ", " * "};
+    Workload ans = {"mixed_int_float", {}};
+    for (int i = 0; i < 100; i++) {
+        string expr = to_string(rng() % 100);
+        for (int j = 1; j < 20; j++) {
+            expr += ops[rng() % 3];
+            expr += j % 2 ? to_string(rng() % 100) + ".25" : to_string(rng() % 100);
+        }
+        ans.exprs.push_back(expr);
+    }
+    return ans;
+}
+
+
+static void tokenize_into(Tokenizer &tokenizer, const string &expr, vector<Token::Ptr> &tokens) {
+    tokenizer.reset();
+    for (size_t i = 0; i <= expr.size(); i++) {
+        tokenizer.feed(expr[i]);
+    }
+    tokens.clear();
+    for (Token::Ptr tok = tokenizer.pop(); tok; tok = tokenizer.pop()) {
+        tokens.push_back(tok);
+    }
+}
+
+
+static void report(const string &name, double ns_per_pass, size_t exprs, size_t tokens) {
+    bench_report(name + "/expr", ns_per_pass / double(exprs), "expr");
+    bench_report(name + "/token", ns_per_pass / double(tokens), "token");
+}
+
+
+static void run_workload(const Workload &workload) {
+    Tokenizer tokenizer;
+    vector<vector<Token::Ptr>> tokens(workload.exprs.size());
+    size_t token_count = 0;
+    for (size_t i = 0; i < workload.exprs.size(); i++) {
+        tokenize_into(tokenizer, workload.exprs[i], tokens[i]);
+        token_count += tokens[i].size();
+    }
+
+    Parser parser;
+    vector<Ast> asts;
+    vector<Program> progs;
+    for (const vector<Token::Ptr> &expr_tokens : tokens) {
+        for (const Token::Ptr &tok : expr_tokens) {
+            parser.feed(tok);
+        }
+        asts.push_back(parser.get_result());
+        parser.reset();
+        progs.push_back(compile_ast(asts.back()));
+    }
+
+    // the evaluators must agree, or the workload is not measuring what it should
+    TokensEvaluator evaluator;
+    VM vm;
+    for (size_t i = 0; i < tokens.size(); i++) {
+        for (const Token::Ptr &tok : tokens[i]) {
+            evaluator.feed(tok);
+        }
+        Value value = evaluator.get_result();
+        evaluator.reset();
+        if (!(value == eval_ast(asts[i])) || !(value == vm.run(progs[i]))) {
+            fprintf(stderr, "%s: the evaluators disagree on %s\n",
+                    workload.name.data(), workload.exprs[i].data());
+            exit(1);
+        }
+    }
+
+    const size_t passes = 2000000 / token_count + 1;
+    const string &name = workload.name;
+    vector<Token::Ptr> scratch;
+    report(name + "/tokenizer", bench_ns(passes, [&]() {
+        for (const string &expr : workload.exprs) {
+            tokenize_into(tokenizer, expr, scratch);
+            do_not_optimize(scratch.data());
+        }
+    }), workload.exprs.size(), token_count);
+
+    report(name + "/parser", bench_ns(passes, [&]() {
+        for (const vector<Token::Ptr> &expr_tokens : tokens) {
+            for (const Token::Ptr &tok : expr_tokens) {
+                parser.feed(tok);
+            }
+            do_not_optimize(parser.get_result().root);
+            parser.reset();
+        }
+    }), workload.exprs.size(), token_count);
+
+    report(name + "/eval_node", bench_ns(passes, [&]() {
+        for (const Ast &ast : asts) {
+            do_not_optimize(eval_node(ast, ast.root));
+        }
+    }), workload.exprs.size(), token_count);
+
+    report(name + "/tokens_evaluator", bench_ns(passes, [&]() {
+        for (const vector<Token::Ptr> &expr_tokens : tokens) {
+            for (const Token::Ptr &tok : expr_tokens) {
+                evaluator.feed(tok);
+            }
+            do_not_optimize(evaluator.get_result());
+            evaluator.reset();
+        }
+    }), workload.exprs.size(), token_count);
+
+    report(name + "/vm", bench_ns(passes, [&]() {
+        for (const Program &prog : progs) {
+            do_not_optimize(vm.run(prog));
+        }
+    }), workload.exprs.size(), token_count);
+}
+
+
+int main() {
+    mt19937_64 rng(25);
+    vector<Workload> workloads = {
+        short_exprs(rng),
+        flat_sums(rng),
+        nested_parens(rng),
+        literals(rng),
+        mixed_types(rng),
+    };
+    for (const Workload &workload : workloads) {
+        run_workload(workload);
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * Compares the streaming Tokenizer::feed() with the batch tokenize() on long inputs.
+ */
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench.hpp"
+#include "../tokenizer.h"
+#include "../tokens.h"
+
+
+using std::pair;
+using std::string;
+using std::to_string;
+using std::vector;
+
+
+static string make_input(size_t terms) {
+    string ans = "0";
+    for (size_t i = 1; i < terms; i++) {
+        ans += i % 3 ? " + " : " * (";
+        ans += to_string(i * 7919 % 100000);
+        ans += i % 5 ? "" : ".25e-1";
+        ans += i % 3 ? "" : ")";
+    }
+    return ans;
+}
+
+
+int main() {
+    vector<pair<string, size_t>> workloads = {
+        {"short", 4},
+        {"long_1k", 1000},
+        {"long_100k", 100000},
+    };
+
+    for (const auto &workload : workloads) {
+        string input = make_input(workload.second);
+        size_t iters = 20000000 / input.size() + 1;
+
+        Tokenizer tokenizer;
+        vector<Token::Ptr> tokens;
+        bench_report(workload.first + "/feed", bench_ns(iters, [&]() {
+            tokenizer.reset();
+            for (size_t i = 0; i <= input.size(); i++) {
+                tokenizer.feed(input[i]);
+            }
+            tokens.clear();
+            for (Token::Ptr tok = tokenizer.pop(); tok; tok = tokenizer.pop()) {
+                tokens.push_back(tok);
+            }
+            do_not_optimize(tokens.data());
+        }));
+
+        bench_report(workload.first + "/tokenize", bench_ns(iters, [&]() {
+            tokenize(input, tokens);
+            do_not_optimize(tokens.data());
+        }));
+    }
+    return 0;
+}
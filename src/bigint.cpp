@@ -0,0 +1,480 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+#include "bigint.h"
+
+
+using std::copy;
+using std::fill;
+using std::ldexp;
+using std::min;
+using std::move;
+using std::swap;
+
+
+typedef vector<uint32_t> Limbs;
+
+static const uint32_t CHUNK = 1000000000;   // the largest power of 10 in a limb
+static const size_t CHUNK_DIGITS = 9;
+// up to this many limbs to_string() takes off one chunk at a time
+static const size_t DECIMAL_THRESHOLD = 30;
+
+
+static void trim(Limbs &x) {
+    while (!x.empty() && x.back() == 0) {
+        x.pop_back();
+    }
+}
+
+
+static int cmp_mag(const Limbs &a, const Limbs &b) {
+    if (a.size() != b.size()) {
+        return a.size() < b.size() ? -1 : 1;
+    }
+    for (size_t i = a.size(); i-- > 0;) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+
+static size_t bit_length(const Limbs &x) {
+    return x.empty() ? 0 : 32 * x.size() - __builtin_clz(x.back());
+}
+
+
+// x[0, nx) += y[0, ny) for nx >= ny, returns the carry out of x
+static uint32_t add_to(uint32_t *x, size_t nx, const uint32_t *y, size_t ny) {
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < ny; i++) {
+        uint64_t t = uint64_t(x[i]) + y[i] + carry;
+        x[i] = uint32_t(t);
+        carry = t >> 32;
+    }
+    for (; carry && i < nx; i++) {
+        uint64_t t = uint64_t(x[i]) + carry;
+        x[i] = uint32_t(t);
+        carry = t >> 32;
+    }
+    return uint32_t(carry);
+}
+
+
+// x[0, nx) -= y[0, ny), x must not be less than y
+static void sub_from(uint32_t *x, size_t nx, const uint32_t *y, size_t ny) {
+    uint64_t borrow = 0;
+    size_t i = 0;
+    for (; i < ny; i++) {
+        uint64_t t = uint64_t(x[i]) - y[i] - borrow;
+        x[i] = uint32_t(t);
+        borrow = t >> 63;
+    }
+    for (; borrow && i < nx; i++) {
+        uint64_t t = uint64_t(x[i]) - borrow;
+        x[i] = uint32_t(t);
+        borrow = t >> 63;
+    }
+    assert(!borrow);
+}
+
+
+static Limbs add_mag(const Limbs &a, const Limbs &b) {
+    const Limbs &longer = a.size() >= b.size() ? a : b;
+    const Limbs &shorter = a.size() >= b.size() ? b : a;
+    Limbs ans(longer.size() + 1);
+    copy(longer.begin(), longer.end(), ans.begin());
+    add_to(ans.data(), ans.size(), shorter.data(), shorter.size());
+    trim(ans);
+    return ans;
+}
+
+
+// a - b for a >= b
+static Limbs sub_mag(const Limbs &a, const Limbs &b) {
+    Limbs ans = a;
+    sub_from(ans.data(), ans.size(), b.data(), b.size());
+    trim(ans);
+    return ans;
+}
+
+
+// out[0, na + nb) += a * b, out must start zeroed
+static void mul_school(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out) {
+    for (size_t i = 0; i < na; i++) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < nb; j++) {
+            uint64_t t = uint64_t(a[i]) * b[j] + out[i + j] + carry;
+            out[i + j] = uint32_t(t);
+            carry = t >> 32;
+        }
+        out[i + nb] = uint32_t(carry);
+    }
+}
+
+
+// out[0, na + nb) = a * b, out must start zeroed
+static void mul_into(const uint32_t *a, size_t na, const uint32_t *b, size_t nb, uint32_t *out) {
+    if (na < nb) {
+        swap(a, b);
+        swap(na, nb);
+    }
+    if (nb < BigInt::KARATSUBA_THRESHOLD) {
+        mul_school(a, na, b, nb, out);
+        return;
+    }
+
+    if (na >= 2 * nb) {
+        // slices of a the size of b make balanced products
+        Limbs part(2 * nb);
+        for (size_t i = 0; i < na; i += nb) {
+            size_t n = min(nb, na - i);
+            fill(part.begin(), part.end(), 0);
+            mul_into(a + i, n, b, nb, part.data());
+            add_to(out + i, na + nb - i, part.data(), n + nb);
+        }
+        return;
+    }
+
+    // a = a1 * B^half + a0, b = b1 * B^half + b0, b1 may be empty
+    size_t half = (na + 1) / 2;
+    const uint32_t *a1 = a + half;
+    const uint32_t *b1 = b + half;
+    size_t na1 = na - half;
+    size_t nb1 = nb - half;
+    mul_into(a, half, b, half, out);                // z0
+    mul_into(a1, na1, b1, nb1, out + 2 * half);     // z2
+
+    // z1 = (a0 + a1) * (b0 + b1) - z0 - z2
+    Limbs sa(half + 1);
+    Limbs sb(half + 1);
+    copy(a, a + half, sa.begin());
+    add_to(sa.data(), sa.size(), a1, na1);
+    copy(b, b + half, sb.begin());
+    add_to(sb.data(), sb.size(), b1, nb1);
+    Limbs z1(2 * half + 2);
+    mul_into(sa.data(), sa.size(), sb.data(), sb.size(), z1.data());
+    sub_from(z1.data(), z1.size(), out, 2 * half);
+    sub_from(z1.data(), z1.size(), out + 2 * half, na1 + nb1);
+    trim(z1);
+    add_to(out + half, na + nb - half, z1.data(), z1.size());
+}
+
+
+static Limbs mul_mag(const Limbs &a, const Limbs &b) {
+    if (a.empty() || b.empty()) {
+        return Limbs();
+    }
+    Limbs ans(a.size() + b.size());
+    mul_into(a.data(), a.size(), b.data(), b.size(), ans.data());
+    trim(ans);
+    return ans;
+}
+
+
+// x = x * m + add
+static void mul_small_add(Limbs &x, uint32_t m, uint32_t add) {
+    uint64_t carry = add;
+    for (uint32_t &limb : x) {
+        uint64_t t = uint64_t(limb) * m + carry;
+        limb = uint32_t(t);
+        carry = t >> 32;
+    }
+    if (carry) {
+        x.push_back(uint32_t(carry));
+    }
+}
+
+
+// x /= d, returns the remainder
+static uint32_t div_small(Limbs &x, uint32_t d) {
+    uint64_t rem = 0;
+    for (size_t i = x.size(); i-- > 0;) {
+        uint64_t cur = (rem << 32) | x[i];
+        x[i] = uint32_t(cur / d);
+        rem = cur % d;
+    }
+    trim(x);
+    return uint32_t(rem);
+}
+
+
+// x << bits with one limb to spare, not trimmed
+static Limbs shift_left(const Limbs &x, size_t bits) {
+    size_t limbs = bits / 32;
+    unsigned s = bits % 32;
+    Limbs ans(x.size() + limbs + 1);
+    for (size_t i = 0; i < x.size(); i++) {
+        uint64_t t = uint64_t(x[i]) << s;
+        ans[i + limbs] |= uint32_t(t);
+        ans[i + limbs + 1] = uint32_t(t >> 32);
+    }
+    return ans;
+}
+
+
+// Knuth's algorithm D, b must not be zero
+static void divmod_mag(const Limbs &a, const Limbs &b, Limbs &q, Limbs &r) {
+    assert(!b.empty());
+    if (cmp_mag(a, b) < 0) {
+        q.clear();
+        r = a;
+        return;
+    }
+    if (b.size() == 1) {
+        q = a;
+        uint32_t rem = div_small(q, b[0]);
+        r.assign(rem != 0, rem);
+        return;
+    }
+
+    // normalize so the top limb of v has its high bit set
+    unsigned s = __builtin_clz(b.back());
+    Limbs v = shift_left(b, s);
+    trim(v);
+    Limbs u = shift_left(a, s);
+    size_t n = v.size();
+    size_t m = a.size() - n;
+    q.assign(m + 1, 0);
+
+    for (size_t j = m + 1; j-- > 0;) {
+        uint64_t num = (uint64_t(u[j + n]) << 32) | u[j + n - 1];
+        uint64_t qhat = num / v[n - 1];
+        uint64_t rhat = num % v[n - 1];
+        while (qhat > UINT32_MAX || qhat * v[n - 2] > ((rhat << 32) | u[j + n - 2])) {
+            qhat--;
+            rhat += v[n - 1];
+            if (rhat > UINT32_MAX) {
+                break;
+            }
+        }
+
+        // u[j, j + n] -= qhat * v
+        int64_t borrow = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t p = qhat * v[i];
+            int64_t t = int64_t(u[i + j]) - borrow - int64_t(p & UINT32_MAX);
+            u[i + j] = uint32_t(t);
+            borrow = int64_t(p >> 32) - (t >> 32);
+        }
+        int64_t t = int64_t(u[j + n]) - borrow;
+        u[j + n] = uint32_t(t);
+
+        if (t < 0) {
+            // qhat was one too large, add v back
+            qhat--;
+            u[j + n] += add_to(&u[j], n, v.data(), n);
+        }
+        q[j] = uint32_t(qhat);
+    }
+    trim(q);
+
+    r.assign(n, 0);
+    for (size_t i = 0; i < n; i++) {
+        r[i] = u[i] >> s;
+        if (s) {
+            r[i] |= uint32_t(uint64_t(u[i + 1]) << (32 - s));
+        }
+    }
+    trim(r);
+}
+
+
+// appends the decimal digits of x, padded with zeros to width
+static void append_decimal(const Limbs &x, const vector<Limbs> &powers, size_t width, string &out) {
+    if (x.size() <= DECIMAL_THRESHOLD) {
+        Limbs rest = x;
+        string digits;  // least significant first
+        while (!rest.empty()) {
+            uint32_t chunk = div_small(rest, CHUNK);
+            for (size_t i = 0; i < CHUNK_DIGITS; i++) {
+                digits.push_back(char('0' + chunk % 10));
+                chunk /= 10;
+            }
+        }
+        while (!digits.empty() && digits.back() == '0') {
+            digits.pop_back();
+        }
+        if (width > digits.size()) {
+            out.append(width - digits.size(), '0');
+        }
+        out.append(digits.rbegin(), digits.rend());
+        return;
+    }
+
+    // the largest power with at most half the limbs of x, so the quotient is not zero
+    size_t k = powers.size() - 1;
+    while (powers[k].size() * 2 > x.size()) {
+        k--;
+    }
+    Limbs high, low;
+    divmod_mag(x, powers[k], high, low);
+    size_t low_width = CHUNK_DIGITS << k;
+    append_decimal(high, powers, width > low_width ? width - low_width : 0, out);
+    append_decimal(low, powers, low_width, out);
+}
+
+
+BigInt::BigInt(int64_t v) {
+    this->negative = v < 0;
+    uint64_t m = this->negative ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+    while (m) {
+        this->mag.push_back(uint32_t(m));
+        m >>= 32;
+    }
+}
+
+
+BigInt BigInt::from_digits(string_view digits) {
+    assert(!digits.empty());
+    BigInt ans;
+    size_t head = digits.size() % CHUNK_DIGITS;
+    size_t pos = 0;
+    while (pos < digits.size()) {
+        size_t len = pos == 0 && head ? head : CHUNK_DIGITS;
+        uint32_t chunk = 0;
+        for (size_t i = pos; i < pos + len; i++) {
+            chunk = chunk * 10 + uint32_t(digits[i] - '0');
+        }
+        mul_small_add(ans.mag, CHUNK, chunk);
+        pos += len;
+    }
+    trim(ans.mag);
+    return ans;
+}
+
+
+bool BigInt::fits_int64() const {
+    if (this->mag.size() > 2) {
+        return false;
+    }
+    uint64_t m = this->mag.empty() ? 0 : this->mag[0];
+    if (this->mag.size() == 2) {
+        m |= uint64_t(this->mag[1]) << 32;
+    }
+    const uint64_t limit = uint64_t(1) << 63;
+    return this->negative ? m <= limit : m < limit;
+}
+
+
+int64_t BigInt::to_int64() const {
+    assert(this->fits_int64());
+    uint64_t m = 0;
+    for (size_t i = this->mag.size(); i-- > 0;) {
+        m = (m << 32) | this->mag[i];
+    }
+    return static_cast<int64_t>(this->negative ? 0 - m : m);
+}
+
+
+double BigInt::to_double() const {
+    size_t bits = bit_length(this->mag);
+    uint64_t top = 0;
+    size_t shift = bits > 64 ? bits - 64 : 0;
+
+    // the 64 bits from shift, with the bits below folded into the lowest one
+    // so converting top rounds like converting the whole number
+    size_t limb = shift / 32;
+    for (size_t i = min(this->mag.size(), limb + 3); i-- > limb;) {
+        unsigned __int128 part = static_cast<unsigned __int128>(this->mag[i]) << (32 * (i - limb));
+        top |= uint64_t(part >> (shift % 32));
+    }
+    bool sticky = shift % 32 && (this->mag[limb] & ((uint32_t(1) << (shift % 32)) - 1));
+    for (size_t i = 0; i < limb && !sticky; i++) {
+        sticky = this->mag[i] != 0;
+    }
+    top |= sticky;
+
+    double ans = ldexp(static_cast<double>(top), int(min(shift, size_t(4096))));
+    return this->negative ? -ans : ans;
+}
+
+
+string BigInt::to_string() const {
+    if (this->mag.empty()) {
+        return "0";
+    }
+    vector<Limbs> powers = {{CHUNK}};
+    while (powers.back().size() * 4 <= this->mag.size()) {
+        powers.push_back(mul_mag(powers.back(), powers.back()));
+    }
+    string ans = this->negative ? "-" : "";
+    append_decimal(this->mag, powers, 0, ans);
+    return ans;
+}
+
+
+BigInt BigInt::operator-() const {
+    BigInt ans = *this;
+    ans.negative = !ans.mag.empty() && !ans.negative;
+    return ans;
+}
+
+
+BigInt BigInt::add(const BigInt &a, const BigInt &b, bool b_negative) {
+    BigInt ans;
+    if (a.negative == b_negative) {
+        ans.mag = add_mag(a.mag, b.mag);
+        ans.negative = a.negative;
+    } else if (cmp_mag(a.mag, b.mag) >= 0) {
+        ans.mag = sub_mag(a.mag, b.mag);
+        ans.negative = a.negative;
+    } else {
+        ans.mag = sub_mag(b.mag, a.mag);
+        ans.negative = b_negative;
+    }
+    ans.negative = ans.negative && !ans.mag.empty();
+    return ans;
+}
+
+
+BigInt BigInt::operator+(const BigInt &other) const {
+    return add(*this, other, other.negative);
+}
+
+
+BigInt BigInt::operator-(const BigInt &other) const {
+    return add(*this, other, !other.negative && !other.mag.empty());
+}
+
+
+BigInt BigInt::operator*(const BigInt &other) const {
+    BigInt ans;
+    ans.mag = mul_mag(this->mag, other.mag);
+    ans.negative = !ans.mag.empty() && this->negative != other.negative;
+    return ans;
+}
+
+
+void BigInt::divmod(const BigInt &a, const BigInt &b, BigInt &quot, BigInt &rem) {
+    Limbs q, r;
+    divmod_mag(a.mag, b.mag, q, r);
+    quot.negative = !q.empty() && a.negative != b.negative;
+    quot.mag = move(q);
+    rem.negative = !r.empty() && a.negative;
+    rem.mag = move(r);
+}
+
+
+double BigInt::div_to_double(const BigInt &a, const BigInt &b) {
+    // scale a so the quotient has at least 65 bits, the remainder then only
+    // matters as a sticky bit below the rounding position
+    size_t abits = bit_length(a.mag);
+    size_t bbits = bit_length(b.mag);
+    size_t shift = bbits + 65 > abits ? bbits + 65 - abits : 0;
+    Limbs scaled = shift_left(a.mag, shift);
+    trim(scaled);
+
+    BigInt q;
+    Limbs r;
+    divmod_mag(scaled, b.mag, q.mag, r);
+    if (!r.empty()) {
+        q.mag[0] |= 1;
+    }
+    double ans = ldexp(q.to_double(), -int(shift));
+    return a.negative != b.negative ? -ans : ans;
+}
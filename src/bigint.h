@@ -0,0 +1,78 @@
+#ifndef CALCXX_BIGINT_H
+#define CALCXX_BIGINT_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+
+/*
+ * An arbitrary-precision integer, stored as a sign and a magnitude of 32 bit
+ * limbs, least significant first.
+ *
+ * Multiplication is schoolbook for small operands and Karatsuba above
+ * KARATSUBA_THRESHOLD limbs. to_string() splits the number by powers of
+ * 10^9 recursively, so most of the work is a few large divisions instead of
+ * one division by 10^9 per output chunk.
+ */
+class BigInt {
+public:
+    static const size_t KARATSUBA_THRESHOLD = 40;
+
+    BigInt() = default;
+    explicit BigInt(int64_t v);
+
+    // digits is a non-empty string of decimal digits
+    static BigInt from_digits(string_view digits);
+
+    bool is_zero() const {
+        return this->mag.empty();
+    }
+
+    bool is_negative() const {
+        return this->negative;
+    }
+
+    bool fits_int64() const;
+    // the value must fit
+    int64_t to_int64() const;
+    // correctly rounded, infinity if out of range
+    double to_double() const;
+    string to_string() const;
+
+    BigInt operator-() const;
+    BigInt operator+(const BigInt &other) const;
+    BigInt operator-(const BigInt &other) const;
+    BigInt operator*(const BigInt &other) const;
+
+    // quotient and remainder truncated toward zero like int64 division, b must not be zero
+    static void divmod(const BigInt &a, const BigInt &b, BigInt &quot, BigInt &rem);
+    // a / b rounded to double, b must not be zero
+    static double div_to_double(const BigInt &a, const BigInt &b);
+
+    bool operator==(const BigInt &other) const {
+        return this->negative == other.negative && this->mag == other.mag;
+    }
+
+    bool operator!=(const BigInt &other) const {
+        return !(*this == other);
+    }
+
+private:
+    // a + b with the sign of b replaced by b_negative
+    static BigInt add(const BigInt &a, const BigInt &b, bool b_negative);
+
+    bool negative = false;
+    vector<uint32_t> mag;   // no leading zero limbs, empty for zero
+};
+
+
+#endif //CALCXX_BIGINT_H
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cassert>
+#include <string>
+
+#include "bytecode.h"
+#include "eval_ast.h"
+#include "stats.h"
+
+
+using std::max;
+using std::string;
+
+
+string repr_program(const Program &prog) {
+    string ans;
+    for (const Instruction &ins : prog.code) {
+        ans += repr(ins);
+        if (ins.code == InsnCode::PUSH) {
+            ans += " ; " + repr(prog.consts[ins.arg]);
+        }
+        ans += "\n";
+    }
+    return ans;
+}
+
+
+static const uint32_t NO_TEMP = UINT32_MAX;
+
+
+/*
+ * Emits the nodes in post-order, the walk tracks the depth of the VM stack.
+ * An operator node with several parents, as intern_ast() makes, is computed
+ * on its first visit and stored to a temp, later visits load the temp instead
+ * of walking the subtree again.
+ */
+Program compile_ast(const Ast &ast) {
+    Program prog;
+    vector<uint32_t> parents(ast.nodes.size(), 0);
+    for (const AstNode &node : ast.nodes) {
+        for (size_t i = 0; i < node.nchildren; i++) {
+            parents[node.children[i]]++;
+        }
+    }
+    vector<uint32_t> temps(ast.nodes.size(), NO_TEMP);
+    uint32_t op_counts[OPCODE_COUNT] = {};
+
+    vector<AstWalkItem> stack;
+    size_t depth = 0;
+    walk_ast(
+        ast, ast.root, stack,
+        [&](NodeId id, const AstNode &node) {
+            node_opcode(node);
+            return temps[id] == NO_TEMP;
+        },
+        [&](NodeId id, const AstNode &node) {
+            if (node.type == TokenType::NAME) {
+                prog.code.push_back({InsnCode::LOAD, OpCode::COUNT, node.slot});
+                prog.max_depth = max(prog.max_depth, ++depth);
+                return;
+            }
+            if (node.is_value()) {
+                prog.consts.push_back(node.value);
+                prog.code.push_back({
+                    InsnCode::PUSH, OpCode::COUNT, static_cast<uint32_t>(prog.consts.size() - 1)
+                });
+                prog.max_depth = max(prog.max_depth, ++depth);
+                return;
+            }
+            if (temps[id] != NO_TEMP) {
+                prog.code.push_back({InsnCode::LOAD_TEMP, OpCode::COUNT, temps[id]});
+                prog.max_depth = max(prog.max_depth, ++depth);
+                return;
+            }
+
+            OpCode op = node_opcode(node);
+            InsnCode code = node.nchildren == 1 ? InsnCode::UNARY : InsnCode::BINARY;
+            prog.code.push_back({code, op, 0});
+            op_counts[static_cast<size_t>(op)]++;
+            depth -= node.nchildren - 1;
+            if (parents[id] > 1) {
+                temps[id] = static_cast<uint32_t>(prog.temp_count++);
+                prog.code.push_back({InsnCode::STORE, OpCode::COUNT, temps[id]});
+            }
+        });
+    prog.var_count = ast.var_names.size();
+    for (size_t i = 0; i < OPCODE_COUNT; i++) {
+        if (op_counts[i] > 0) {
+            prog.op_counts.push_back({static_cast<OpCode>(i), op_counts[i]});
+        }
+    }
+    return prog;
+}
+
+
+Value VM::run(const Program &prog, const Value *vars) {
+    assert(vars || prog.var_count == 0);
+    if (this->stack.size() < prog.max_depth) {
+        this->stack.resize(prog.max_depth);
+    }
+    if (this->temps.size() < prog.temp_count) {
+        this->temps.resize(prog.temp_count);
+    }
+    if (stats_enabled()) {
+        for (const OpCount &ops : prog.op_counts) {
+            record_op_calls(ops.op, ops.count);
+        }
+    }
+
+    Value *const base = this->stack.data();
+    Value *sp = base;
+    for (const Instruction &ins : prog.code) {
+        switch (ins.code) {
+        case InsnCode::PUSH:
+            *sp++ = prog.consts[ins.arg];
+            break;
+        case InsnCode::LOAD:
+            *sp++ = vars[ins.arg];
+            break;
+        case InsnCode::STORE:
+            this->temps[ins.arg] = sp[-1];
+            break;
+        case InsnCode::LOAD_TEMP:
+            *sp++ = this->temps[ins.arg];
+            break;
+        case InsnCode::UNARY:
+            sp[-1] = apply_unary(ins.op, sp[-1]);
+            break;
+        case InsnCode::BINARY:
+            sp[-2] = apply_binary(ins.op, sp[-2], sp[-1]);
+            sp--;
+            break;
+        }
+    }
+
+    assert(sp == base + 1);
+    return *base;
+}
@@ -0,0 +1,94 @@
+#ifndef CALCXX_BYTECODE_H
+#define CALCXX_BYTECODE_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+#include "operators.h"
+#include "utils.hpp"
+#include "value.h"
+
+
+using std::string;
+using std::vector;
+
+
+enum class InsnCode : uint8_t {
+    PUSH,   // push consts[arg]
+    LOAD,   // push vars[arg]
+    STORE,  // copy the top value to temps[arg], it stays on the stack
+    LOAD_TEMP,  // push temps[arg]
+    UNARY,  // replace the top value with op(top)
+    BINARY, // pop two values, push op(lhs, rhs)
+};
+
+
+struct Instruction {
+    InsnCode code;
+    OpCode op;
+    uint32_t arg;
+};
+
+
+REPR(Instruction) {
+    switch (value.code) {
+    case InsnCode::PUSH:
+        return "PUSH " + to_string(value.arg);
+    case InsnCode::LOAD:
+        return "LOAD " + to_string(value.arg);
+    case InsnCode::STORE:
+        return "STORE " + to_string(value.arg);
+    case InsnCode::LOAD_TEMP:
+        return "LOAD_TEMP " + to_string(value.arg);
+    case InsnCode::UNARY:
+        return "UNARY " + repr(value.op);
+    case InsnCode::BINARY:
+        return "BINARY " + repr(value.op);
+    }
+    return "";
+}
+
+
+// how many UNARY or BINARY instructions of a program apply op
+struct OpCount {
+    OpCode op;
+    uint32_t count;
+};
+
+
+/*
+ * A flattened post-order form of an AST, evaluated by VM.
+ * Compile once with compile_ast() and run as many times as needed.
+ */
+struct Program {
+    vector<Instruction> code;
+    vector<Value> consts;
+    size_t max_depth = 0;
+    size_t var_count = 0;   // LOAD reads vars[0] to vars[var_count - 1]
+    size_t temp_count = 0;  // values of shared subtrees, see compile_ast()
+    // the operators of code, added to the stats by each run without scanning code
+    vector<OpCount> op_counts;
+};
+
+
+string repr_program(const Program &prog);
+// ast may be a DAG, see intern_ast()
+Program compile_ast(const Ast &ast);
+
+
+class VM {
+public:
+    // vars may be null if prog has no variables
+    Value run(const Program &prog, const Value *vars = nullptr);
+
+private:
+    vector<Value> stack;
+    vector<Value> temps;
+};
+
+
+#endif //CALCXX_BYTECODE_H
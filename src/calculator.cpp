@@ -0,0 +1,112 @@
+#include <string>
+
+#include "calculator.h"
+#include "exception.h"
+#include "stats.h"
+#include "tokenizer.h"
+
+
+using std::string;
+
+
+static LineResult error_result(
+    const string &type, const BaseException &exc, const SourcePos &start, const SourcePos &end)
+{
+    LineResult ans;
+    ans.status = LineStatus::error;
+    ans.error = type + ": " + exc.what();
+    while (!ans.error.empty() && ans.error.back() == '\n') {
+        ans.error.pop_back();
+    }
+    ans.start = start;
+    ans.end = end;
+    return ans;
+}
+
+
+LineResult Calculator::eval_line(string_view line) {
+    switch (this->mode) {
+    case EvalMode::ast:
+        return this->eval_tokens(line, this->ast_evaluator);
+    case EvalMode::bytecode:
+        return this->eval_tokens(line, this->bytecode_evaluator);
+    case EvalMode::tokens:
+        return this->eval_tokens(line, this->tokens_evaluator);
+    }
+    return LineResult();
+}
+
+
+LineResult Calculator::dump_line(string_view line, string &text) {
+    LineResult ans = this->eval_tokens(line, this->ast_dumper, true);
+    text.swap(this->ast_dumper.text);
+    this->ast_dumper.text.clear();
+    return ans;
+}
+
+
+template<class EvaluatorType>
+LineResult Calculator::eval_tokens(string_view line, EvaluatorType &evaluator, bool allow_names) {
+    LineResult ans;
+    // --dump-ast needs the trees, it does not use the cache
+    bool use_cache = this->cache.capacity() > 0 && !allow_names;
+    if (use_cache) {
+        // the miss is counted on the token key, so a line counts once
+        ResultCache::line_key(line, this->line_key);
+        if (this->cache.lookup(this->line_key, ans.value, false)) {
+            ans.status = LineStatus::ok;
+            return ans;
+        }
+    }
+
+    PhaseTimer timer;
+    try {
+        tokenize(line, this->tokens);
+    } catch (const TokenizerError &exc) {
+        return error_result("TokenizerError", exc, exc.pos, exc.pos);
+    }
+    timer.lap(Phase::tokenize);
+
+    if (this->tokens.size() == 1) {
+        return ans;     // only the END token
+    }
+
+    if (use_cache) {
+        ResultCache::token_key(this->tokens, this->token_key);
+        if (this->cache.lookup(this->token_key, ans.value)) {
+            this->cache.insert(this->line_key, ans.value);
+            ans.status = LineStatus::ok;
+            return ans;
+        }
+    }
+
+    for (const Token::Ptr &tok : this->tokens) {
+        try {
+            if (tok->type == TokenType::NAME && !allow_names) {
+                throw EvalError(
+                    "unbound variable: " + static_cast<const TokenName &>(*tok).name + "\n");
+            }
+            evaluator.feed(tok);
+            if (tok->type == TokenType::END) {
+                timer.lap(Phase::parse);
+                ans.status = LineStatus::ok;
+                ans.value = evaluator.get_result();
+                timer.lap(Phase::evaluate);
+                break;
+            }
+        } catch (const EvalError &exc) {
+            ans = error_result("EvalError", exc, tok->start, tok->end);
+            break;
+        } catch (const ParserError &exc) {
+            ans = error_result("ParserError", exc, tok->start, tok->end);
+            break;
+        }
+    }
+    evaluator.reset();
+
+    if (use_cache && ans.status == LineStatus::ok) {
+        this->cache.insert(this->token_key, ans.value);
+        this->cache.insert(this->line_key, ans.value);
+    }
+    return ans;
+}
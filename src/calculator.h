@@ -0,0 +1,166 @@
+#ifndef CALCXX_CALCULATOR_H
+#define CALCXX_CALCULATOR_H
+
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bytecode.h"
+#include "eval.h"
+#include "eval_ast.h"
+#include "parser.h"
+#include "result_cache.h"
+#include "simplify.h"
+#include "sourcepos.h"
+#include "tokens.h"
+#include "value.h"
+
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+
+class AstEvaluator {
+public:
+    AstEvaluator() {}
+
+    void feed(const Token::Ptr &tok) {
+        this->parser.feed(tok);
+    }
+
+    Value get_result() {
+        return eval_ast(this->parser.get_result());
+    }
+
+    void reset() {
+        this->parser.reset();
+    }
+
+private:
+    Parser parser;
+};
+
+
+class BytecodeEvaluator {
+public:
+    BytecodeEvaluator() {}
+
+    void feed(const Token::Ptr &tok) {
+        this->parser.feed(tok);
+    }
+
+    Value get_result() {
+        simplify_ast(this->parser.get_result(), this->simplified);
+        Program prog = compile_ast(this->simplified);
+        return this->vm.run(prog);
+    }
+
+    void reset() {
+        this->parser.reset();
+    }
+
+private:
+    Parser parser;
+    Ast simplified;
+    VM vm;
+};
+
+
+/*
+ * Evaluates like AstEvaluator after simplify_ast(), keeping both trees
+ * as text for --dump-ast.
+ */
+class AstDumper {
+public:
+    string text;
+
+    void feed(const Token::Ptr &tok) {
+        this->parser.feed(tok);
+    }
+
+    // text is set even if evaluation throws, e.g. for an unbound variable
+    Value get_result() {
+        const Ast &ast = this->parser.get_result();
+        simplify_ast(ast, this->simplified);
+        this->text = "ast:\n" + repr(ast) + "simplified:\n" + repr(this->simplified);
+        return eval_ast(this->simplified);
+    }
+
+    void reset() {
+        this->parser.reset();
+    }
+
+private:
+    Parser parser;
+    Ast simplified;
+};
+
+
+enum class EvalMode {
+    ast,
+    bytecode,
+    tokens,
+};
+
+
+enum class LineStatus {
+    ok,
+    blank,
+    error,
+};
+
+
+struct LineResult {
+    LineStatus status = LineStatus::blank;
+    Value value = Value::of_int(0);
+    string error;       // "<ExceptionType>: <message>" without trailing newline
+    SourcePos start;    // span of the offending input
+    SourcePos end;
+};
+
+
+/*
+ * Tokenizes and evaluates one line at a time with the selected evaluator,
+ * reusing its buffers between lines. Positions are relative to the line.
+ *
+ * With a cache_size, the values of lines that evaluate without error are kept
+ * in a ResultCache of that many entries. A line is looked up by its text, then
+ * after tokenizing by its tokens, and on a hit it is not evaluated again.
+ * Both keys are inserted, so a line takes up to two entries.
+ * Each line with tokens counts as one hit or one miss of the cache.
+ */
+class Calculator {
+public:
+    explicit Calculator(EvalMode mode = EvalMode::ast, size_t cache_size = 0)
+        : mode(mode), cache(cache_size)
+    {}
+
+    LineResult eval_line(string_view line);
+    // evaluates line like eval_line(), text gets the AST before and after simplify_ast()
+    // if the line parses, variables are accepted but fail to evaluate
+    LineResult dump_line(string_view line, string &text);
+
+    const ResultCache &result_cache() const {
+        return this->cache;
+    }
+
+private:
+    EvalMode mode;
+    ResultCache cache;
+    string line_key;
+    string token_key;
+    vector<Token::Ptr> tokens;
+    AstEvaluator ast_evaluator;
+    BytecodeEvaluator bytecode_evaluator;
+    TokensEvaluator tokens_evaluator;
+    AstDumper ast_dumper;
+
+    template<class EvaluatorType>
+    // variables can not be bound from a line, allow_names only lets them reach the evaluator
+    LineResult eval_tokens(string_view line, EvaluatorType &evaluator, bool allow_names = false);
+};
+
+
+#endif //CALCXX_CALCULATOR_H
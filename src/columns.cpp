@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <string>
+
+#include "columns.h"
+#include "exception.h"
+#include "operators.h"
+
+
+using std::from_chars;
+using std::max;
+using std::memcpy;
+using std::memset;
+using std::min;
+using std::string;
+using std::to_string;
+
+
+union BlockData {
+    int64_t ivals[BATCH_SIZE];
+    double fvals[BATCH_SIZE];
+};
+
+
+struct BlockRef {
+    BatchType type;
+    const void *data;
+};
+
+
+// buffers for eval(), allocated once per call
+struct BlockContext {
+    vector<BlockRef> consts;        // each constant repeated over a block
+    vector<BlockRef> inputs;        // rows of the current block, by variable slot
+    vector<BlockRef> stack;
+    vector<BlockRef> temps;
+    vector<BlockData> const_data;
+    vector<BlockData> temp_data;    // copies of stored values, scratch blocks get reused
+    vector<BlockData> tail_data;    // padded inputs of a last partial block
+    vector<BlockData> scratch;      // two blocks per stack depth
+
+    // a block of depth to write to, not the one used by the value it replaces
+    BlockData *output_block(size_t depth, const void *used) {
+        BlockData *block = &this->scratch[2 * depth];
+        return block == used ? block + 1 : block;
+    }
+};
+
+
+static const void *column_rows(const Column &col, size_t start) {
+    if (col.type == ValueType::INT) {
+        return static_cast<const int64_t *>(col.data) + start;
+    } else {
+        return static_cast<const double *>(col.data) + start;
+    }
+}
+
+
+static Value column_value(const Column &col, size_t row) {
+    if (col.type == ValueType::INT) {
+        return Value::of_int(static_cast<const int64_t *>(col.data)[row]);
+    } else {
+        return Value::of_float(static_cast<const double *>(col.data)[row]);
+    }
+}
+
+
+static BatchType batch_type(ValueType type) {
+    return type == ValueType::INT ? BatchType::INT : BatchType::FLOAT;
+}
+
+
+// returns false if a kernel gave MIXED, the block must then be evaluated row by row
+static bool eval_block(const Program &prog, BlockContext &ctx, size_t n, Value *out) {
+    BlockRef *const base = ctx.stack.data();
+    BlockRef *sp = base;
+    for (const Instruction &ins : prog.code) {
+        size_t op = static_cast<size_t>(ins.op);
+        BlockData *dst;
+        BatchType type;
+        switch (ins.code) {
+        case InsnCode::PUSH:
+            *sp++ = ctx.consts[ins.arg];
+            break;
+        case InsnCode::LOAD:
+            *sp++ = ctx.inputs[ins.arg];
+            break;
+        case InsnCode::STORE:
+            memcpy(&ctx.temp_data[ins.arg], sp[-1].data, n * sizeof(int64_t));
+            ctx.temps[ins.arg] = {sp[-1].type, &ctx.temp_data[ins.arg]};
+            break;
+        case InsnCode::LOAD_TEMP:
+            *sp++ = ctx.temps[ins.arg];
+            break;
+        case InsnCode::UNARY:
+            dst = ctx.output_block(sp - base - 1, sp[-1].data);
+            type = g_batch_unary_kernels[op][kernel_index(sp[-1].type)](sp[-1].data, dst, n);
+            sp[-1] = {type, dst};
+            break;
+        case InsnCode::BINARY:
+            dst = ctx.output_block(sp - base - 2, sp[-2].data);
+            type = g_batch_binary_kernels[op][kernel_index(sp[-2].type, sp[-1].type)](
+                sp[-2].data, sp[-1].data, dst, n);
+            if (type == BatchType::MIXED) {
+                return false;
+            }
+            sp[-2] = {type, dst};
+            sp--;
+            break;
+        }
+    }
+
+    if (base->type == BatchType::INT) {
+        const int64_t *ivals = static_cast<const int64_t *>(base->data);
+        for (size_t i = 0; i < n; i++) {
+            out[i] = Value::of_int(ivals[i]);
+        }
+    } else {
+        const double *fvals = static_cast<const double *>(base->data);
+        for (size_t i = 0; i < n; i++) {
+            out[i] = Value::of_float(fvals[i]);
+        }
+    }
+    return true;
+}
+
+
+ColumnFormula::ColumnFormula(string_view text) : formula(text) {
+    for (const string &name : this->formula.var_names()) {
+        size_t col = 0;
+        const char *end = name.data() + name.size();
+        std::from_chars_result parsed = from_chars(name.data() + 1, end, col);
+        if (name[0] != '$' || parsed.ec != std::errc() || parsed.ptr != end) {
+            throw ArgumentError("expected column placeholders like $0, got " + name + "\n");
+        }
+        this->slot_columns.push_back(col);
+        this->ncolumns = max(this->ncolumns, col + 1);
+    }
+}
+
+
+void ColumnFormula::eval(const vector<Column> &columns, size_t rows, Value *out) const {
+    if (columns.size() < this->ncolumns) {
+        throw ArgumentError(
+            "expected " + to_string(this->ncolumns) + " columns"
+                + ", got " + to_string(columns.size()) + "\n"
+        );
+    }
+
+    const Program &prog = this->formula.get_program();
+    size_t nvars = this->slot_columns.size();
+
+    // the batch kernels only take int64 and double, a BIG constant means row by row
+    bool batched = true;
+    BlockContext ctx;
+    ctx.const_data.resize(prog.consts.size());
+    ctx.consts.reserve(prog.consts.size());
+    for (size_t k = 0; k < prog.consts.size(); k++) {
+        const Value &value = prog.consts[k];
+        batched = batched && value.type != ValueType::BIG;
+        BlockData &block = ctx.const_data[k];
+        for (size_t i = 0; i < BATCH_SIZE; i++) {
+            if (value.is_int()) {
+                block.ivals[i] = value.ival;
+            } else if (value.type == ValueType::FLOAT) {
+                block.fvals[i] = value.fval;
+            }
+        }
+        ctx.consts.push_back({batch_type(value.type), &block});
+    }
+    ctx.inputs.resize(nvars);
+    ctx.tail_data.resize(nvars);
+    ctx.stack.resize(prog.max_depth);
+    ctx.temps.resize(prog.temp_count);
+    ctx.temp_data.resize(prog.temp_count);
+    ctx.scratch.resize(2 * prog.max_depth);
+
+    VM vm;
+    vector<Value> vars(nvars);
+    for (size_t start = 0; start < rows; start += BATCH_SIZE) {
+        size_t n = min(BATCH_SIZE, rows - start);
+        for (size_t slot = 0; slot < nvars; slot++) {
+            const Column &col = columns[this->slot_columns[slot]];
+            const void *data = column_rows(col, start);
+            if (n < BATCH_SIZE) {
+                BlockData &tail = ctx.tail_data[slot];
+                memset(&tail, 0, sizeof(tail));
+                memcpy(&tail, data, n * sizeof(int64_t));
+                data = &tail;
+            }
+            ctx.inputs[slot] = {batch_type(col.type), data};
+        }
+
+        if (batched && eval_block(prog, ctx, n, out + start)) {
+            continue;
+        }
+        for (size_t row = start; row < start + n; row++) {
+            for (size_t slot = 0; slot < nvars; slot++) {
+                vars[slot] = column_value(columns[this->slot_columns[slot]], row);
+            }
+            out[row] = this->formula.eval(vars, vm);
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef CALCXX_COLUMNS_H
+#define CALCXX_COLUMNS_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "formula.h"
+#include "value.h"
+
+
+using std::string_view;
+using std::vector;
+
+
+// the input rows of one placeholder, all int64_t or all double
+struct Column {
+    ValueType type;
+    const void *data;
+
+    static Column of_ints(const int64_t *data) {
+        return {ValueType::INT, data};
+    }
+
+    static Column of_floats(const double *data) {
+        return {ValueType::FLOAT, data};
+    }
+};
+
+
+/*
+ * Evaluates one expression over many rows of columnar input, the placeholders
+ * $0, $1, ... stand for the rows of columns[0], columns[1], ...
+ * Rows are evaluated BATCH_SIZE at a time with one batch kernel call per
+ * instruction, so the interpretation cost is paid per block instead of per row.
+ * Results are the same as evaluating each row with Formula.
+ */
+class ColumnFormula {
+public:
+    // throws TokenizerError, ParserError, or ArgumentError for variables that are not $N
+    explicit ColumnFormula(string_view text);
+
+    // one more than the highest placeholder
+    size_t column_count() const {
+        return this->ncolumns;
+    }
+
+    // out[row] for row in [0, rows), throws ArgumentError if columns is too short
+    void eval(const vector<Column> &columns, size_t rows, Value *out) const;
+
+    const Formula &get_formula() const {
+        return this->formula;
+    }
+
+private:
+    Formula formula;
+    vector<size_t> slot_columns;    // column of each variable slot
+    size_t ncolumns = 0;
+};
+
+
+#endif //CALCXX_COLUMNS_H
@@ -1,49 +1,53 @@
-#include <algorithm>
 #include <cassert>
-#include <map>
-#include <memory>
-#include <stdexcept>
 #include <string>
 #include <vector>
+
 #include "eval.h"
 #include "operators.h"
+#include "stats.h"
 #include "utils.hpp"
 
 
-using std::map;
-using std::out_of_range;
-using std::reverse;
 using std::string;
 using std::vector;
 
 
-static map<TokenType, vector<string>> g_operator_sigs = {
-    {TokenType::PLUS, {"if", "if"}},
-    {TokenType::MINUS, {"if", "if"}},
-    {TokenType::MULT, {"if", "if"}},
-    {TokenType::DIV, {"if", "if"}}
-};
-static map<TokenType, int> g_operator_precedence = {
-    {TokenType::LPAR, -1},
-    {TokenType::PLUS, 1},
-    {TokenType::MINUS, 1},
-    {TokenType::MULT, 2},
-    {TokenType::DIV, 2},
-    {TokenType::RPAR, -2},
-    {TokenType::END, -3}
-};
+// precedence of the tokens that are not operators
+static const int LPAR_PRECEDENCE = -1;
+static const int RPAR_PRECEDENCE = -2;
+static const int END_PRECEDENCE = -3;
+
+
+static int token_precedence(TokenType tt) {
+    switch (tt) {
+    case TokenType::LPAR:
+        return LPAR_PRECEDENCE;
+    case TokenType::RPAR:
+        return RPAR_PRECEDENCE;
+    case TokenType::END:
+        return END_PRECEDENCE;
+    default:
+        break;
+    }
+
+    OpCode op = token_opcode(tt, 2);
+    if (op == OpCode::COUNT) {
+        throw EvalError("Operation precedence unknown");
+    }
+    return op_info(op).precedence;
+}
 
 
 void TokensEvaluator::feed(const Token::Ptr &tok) {
-    if (*tok == Token(TokenType::LPAR)) {
-        this->ops.push(tok);
+    if (tok->type == TokenType::LPAR) {
+        this->ops.push_back(tok->type);
     } else if (tok->is_op()) {
-        while (!this->ops.empty() && !operator_lt(this->ops.top(), tok)) {
-            if (this->ops.top()->type == TokenType::LPAR) {
+        while (!this->ops.empty() && !operator_lt(this->ops.back(), tok->type)) {
+            if (this->ops.back() == TokenType::LPAR) {
                 if (tok->type != TokenType::RPAR) {
                     throw EvalError("Unclosed left parenthesis.");
                 }
-                this->ops.pop();
+                this->ops.pop_back();
                 return;
             } else {
                 this->eval_top();
@@ -53,26 +57,35 @@ void TokensEvaluator::feed(const Token::Ptr &tok) {
         if (tok->type == TokenType::END) {
             this->check_result();
         } else {
-            this->ops.push(tok);
+            this->ops.push_back(tok->type);
         }
     } else {
-        this->values.push(tok);
+        this->values.push_back(token_to_value(*tok));
     }
 }
 
 void TokensEvaluator::eval_top() {
     assert(!this->ops.empty());
-    Token::Ptr tok = this->ops.top();
-    this->ops.pop();
-    auto it = g_builtin_operator_table.find(tok->type);
-    if (it != g_builtin_operator_table.end()) {
-        auto func = it->second;
-        const vector<string> &sigs = g_operator_sigs.find(tok->type)->second;
-        vector<Token::Ptr> args = extract_argument(this->values, sigs);
-        Token::Ptr result = func(args);
-        this->values.push(result);
-    } else {
-        throw NotImplementedOperation(string(1, static_cast<char>(tok->type)));
+    TokenType type = this->ops.back();
+    this->ops.pop_back();
+
+    OpCode op = token_opcode(type, 2);
+    if (op == OpCode::COUNT) {
+        throw NotImplementedOperation(string(1, static_cast<char>(type)));
+    }
+    if (this->values.size() < 2) {
+        throw ArgumentError(
+            "missing argument, expected 2 argument"
+                ", only " + repr(this->values.size()) + " argument available\n"
+        );
+    }
+
+    // the result replaces the left argument in place
+    Value rhs = this->values.back();
+    this->values.pop_back();
+    this->values.back() = apply_binary(op, this->values.back(), rhs);
+    if (stats_enabled()) {
+        record_op_calls(op);
     }
 }
 
@@ -83,52 +96,28 @@ void TokensEvaluator::check_result() {
     }
 }
 
-Token::Ptr TokensEvaluator::get_result() {
+Value TokensEvaluator::get_result() {
     if (!this->is_finished()) {
         throw EvalError("Not finished");
     }
-    Token::Ptr tok = this->values.top();
-    this->values.pop();
-    return tok;
+    Value value = this->values.back();
+    this->values.pop_back();
+    return value;
 }
 
 void TokensEvaluator::reset() {
-    stack<Token::Ptr>().swap(this->ops);
-    stack<Token::Ptr>().swap(this->values);
-}
-
-
-bool operator_lt(const Token::Ptr &op1, const Token::Ptr &op2) {
-    try {
-        return g_operator_precedence.at(op1->type) < g_operator_precedence.at(op2->type);
-    } catch (const out_of_range &) {
-        throw EvalError("Operation precedence unknown");
-    }
+    this->ops.clear();
+    this->values.clear();
 }
 
 
-vector<Token::Ptr>
-extract_argument(stack<Token::Ptr> &stack, const vector<string> &spec) {
-    if (stack.size() < spec.size()) {
-        throw ArgumentError(
-            "missing argument, expected " + repr(spec.size()) + " argument"
-                + ", only " + repr(stack.size()) + " argument available\n"
-        );
-    }
-
-    vector<Token::Ptr> ans;
-    for (string s : spec) {
-        Token::Ptr tok = stack.top();
-        stack.pop();
-        char type = static_cast<char>(tok->type);
-        if (s.find(type) != string::npos) {
-            ans.push_back(tok);
-        } else {
-            throw ArgumentError(
-                "argument type mismatch, expected '" + s + "', got " + string(1, type) + "\n"
-            );
-        }
+// op2 is about to be pushed, op1 on the top of ops must be evaluated first unless op1 < op2
+bool operator_lt(TokenType op1, TokenType op2) {
+    int p1 = token_precedence(op1);
+    int p2 = token_precedence(op2);
+    OpCode op = token_opcode(op2, 2);
+    if (p1 == p2 && op != OpCode::COUNT && op_info(op).assoc == Assoc::RIGHT) {
+        return true;
     }
-    reverse(ans.begin(), ans.end());
-    return ans;
+    return p1 < p2;
 }
@@ -2,27 +2,23 @@
 #define CALCXX_EVAL_H
 
 
-#include <stack>
-#include <string>
 #include <vector>
 
 #include "exception.h"
 #include "tokens.h"
+#include "value.h"
 
 
-using std::stack;
-using std::string;
 using std::vector;
 
 
-vector<Token::Ptr> extract_argument(stack<Token::Ptr> &stack, const vector<string> &spec);
-bool operator_lt(const Token::Ptr &op1, const Token::Ptr &op2);
+bool operator_lt(TokenType op1, TokenType op2);
 
 
 class TokensEvaluator {
 public:
     void feed(const Token::Ptr &tok);
-    Token::Ptr get_result();;
+    Value get_result();;
     void reset();
 
     bool is_finished() const {
@@ -30,8 +26,8 @@ public:
     }
 
 private:
-    stack<Token::Ptr> ops;
-    stack<Token::Ptr> values;
+    vector<TokenType> ops;
+    vector<Value> values;
 
     void eval_top();
     void check_result();
@@ -1,39 +1,131 @@
-#include <algorithm>
-#include <iterator>
+#include <cassert>
 #include <string>
 #include <vector>
 
 #include "eval_ast.h"
 #include "exception.h"
 #include "operators.h"
+#include "stats.h"
 #include "tokens.h"
 
 
-using std::back_inserter;
 using std::string;
-using std::transform;
 using std::vector;
 
 
-static bool is_value_type(const Token::Ptr &tok) {
-    return tok->type == TokenType::INT || tok->type == TokenType::FLOAT;
+OpCode node_opcode(const AstNode &node) {
+    if (node.op != OpCode::COUNT) {
+        return node.op;
+    }
+
+    TokenType tt = node.type;
+    size_t nargs = node.nchildren;
+
+    if (token_opcode(tt, 1) == OpCode::COUNT && token_opcode(tt, 2) == OpCode::COUNT) {
+        throw NotImplementedOperation(string(1, static_cast<char>(tt)));
+    }
+    throw ArgumentError(
+        "bad number of arguments for '" + string(1, static_cast<char>(tt)) + "'"
+            + ", got " + repr(nargs) + "\n"
+    );
 }
 
 
-Token::Ptr eval_node(const Node::Ptr &node) {
-    if (is_value_type(node->token)) {
-        return node->token;
+// evaluates with explicit stacks of pending nodes and operand values,
+// the depth of the tree only costs heap memory
+static Value eval_walk(const Ast &ast, NodeId id, const Value *vars, uint64_t *op_counts) {
+    vector<AstWalkItem> stack;
+    vector<Value> values;
+    walk_ast(
+        ast, id, stack,
+        [](NodeId, const AstNode &node) {
+            node_opcode(node);
+            return true;
+        },
+        [&](NodeId, const AstNode &node) {
+            if (node.type == TokenType::NAME) {
+                if (!vars) {
+                    throw EvalError("unbound variable: " + ast.var_names[node.slot] + "\n");
+                }
+                values.push_back(vars[node.slot]);
+                return;
+            }
+            if (node.is_value()) {
+                values.push_back(node.value);
+                return;
+            }
+            OpCode op = node_opcode(node);
+            if (op_counts) {
+                op_counts[static_cast<size_t>(op)]++;
+            }
+            if (node.nchildren == 1) {
+                values.back() = apply_unary(op, values.back());
+            } else {
+                Value &lhs = values[values.size() - 2];
+                lhs = apply_binary(op, lhs, values.back());
+                values.pop_back();
+            }
+        });
+
+    assert(values.size() == 1);
+    return values.back();
+}
+
+
+// op_counts is null unless stats are enabled, it counts the operators applied
+static Value eval_recursive(
+    const Ast &ast, NodeId id, const Value *vars, uint64_t *op_counts, size_t depth
+) {
+    const AstNode &node = ast[id];
+    if (node.type == TokenType::NAME) {
+        if (!vars) {
+            throw EvalError("unbound variable: " + ast.var_names[node.slot] + "\n");
+        }
+        return vars[node.slot];
+    }
+    if (node.is_value()) {
+        return node.value;
+    }
+    if (depth == MAX_AST_RECURSION) {
+        return eval_walk(ast, id, vars, op_counts);
     }
 
-    TokenType tt = node->token->type;
-    auto it = g_builtin_operator_table.find(tt);
-    if (it != g_builtin_operator_table.end()) {
-        auto func = it->second;
-        vector<Token::Ptr> args;
-        const Node::Container &children = node->children;
-        transform(children.begin(), children.end(), back_inserter(args), eval_node);
-        return func(args);
+    // checked before the operands, as eval_walk() does
+    OpCode op = node_opcode(node);
+    if (node.nchildren == 1) {
+        Value arg = eval_recursive(ast, node.children[0], vars, op_counts, depth + 1);
+        if (op_counts) {
+            op_counts[static_cast<size_t>(op)]++;
+        }
+        return apply_unary(op, arg);
     } else {
-        throw NotImplementedOperation(string(1, static_cast<char>(tt)));
+        Value lhs = eval_recursive(ast, node.children[0], vars, op_counts, depth + 1);
+        Value rhs = eval_recursive(ast, node.children[1], vars, op_counts, depth + 1);
+        if (op_counts) {
+            op_counts[static_cast<size_t>(op)]++;
+        }
+        return apply_binary(op, lhs, rhs);
+    }
+}
+
+
+// the operators are counted during the evaluation, not by walking the tree again,
+// and added to the stats once per call
+Value eval_node(const Ast &ast, NodeId id, const Value *vars) {
+    if (!stats_enabled()) {
+        return eval_recursive(ast, id, vars, nullptr, 0);
+    }
+    uint64_t op_counts[OPCODE_COUNT] = {};
+    Value ans = eval_recursive(ast, id, vars, op_counts, 0);
+    for (size_t i = 0; i < OPCODE_COUNT; i++) {
+        if (op_counts[i] > 0) {
+            record_op_calls(static_cast<OpCode>(i), op_counts[i]);
+        }
     }
+    return ans;
+}
+
+
+Value eval_ast(const Ast &ast, const Value *vars) {
+    return eval_node(ast, ast.root, vars);
 }
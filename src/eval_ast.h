@@ -2,10 +2,17 @@
 #define CALCXX_EVAL_AST_H
 
 
-#include "node.h"
+#include "ast.h"
+#include "operators.h"
+#include "value.h"
 
 
-Token::Ptr eval_node(const Node::Ptr &node);
+// throws if node is not an operator applied to a supported number of arguments
+OpCode node_opcode(const AstNode &node);
+// vars[slot] is the value of each variable of ast, variables are unbound if vars is null,
+// operands are evaluated left to right with bounded recursion, any depth is fine
+Value eval_node(const Ast &ast, NodeId id, const Value *vars = nullptr);
+Value eval_ast(const Ast &ast, const Value *vars = nullptr);
 
 
 #endif //CALCXX_EVAL_AST_H
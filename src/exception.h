@@ -5,6 +5,8 @@
 #include <exception>
 #include <string>
 
+#include "sourcepos.h"
+
 
 using std::exception;
 using std::string;
@@ -22,7 +24,11 @@ public:
 
 class TokenizerError : public BaseException {
 public:
-    explicit TokenizerError(const string &msg) : BaseException(msg) {}
+    SourcePos pos;  // position of the offending char, if known
+
+    explicit TokenizerError(const string &msg, const SourcePos &pos = SourcePos())
+        : BaseException(msg), pos(pos)
+    {}
 };
 
 class ParserError : public BaseException {
@@ -30,6 +36,11 @@ public:
     explicit ParserError(const string &msg) : BaseException(msg) {};
 };
 
+class IOError : public BaseException {
+public:
+    explicit IOError(const string &msg) : BaseException(msg) {}
+};
+
 class EvalError : public BaseException {
 public:
     explicit EvalError(const string &msg) : BaseException(msg) {};
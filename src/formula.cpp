@@ -0,0 +1,43 @@
+#include <string>
+
+#include "exception.h"
+#include "formula.h"
+#include "intern.h"
+#include "parser.h"
+#include "simplify.h"
+#include "tokenizer.h"
+
+
+using std::to_string;
+
+
+Formula::Formula(string_view text) {
+    vector<Token::Ptr> tokens;
+    tokenize(text, tokens);
+
+    Parser parser;
+    for (const Token::Ptr &tok : tokens) {
+        parser.feed(tok);
+    }
+    Ast simplified;
+    simplify_ast(parser.get_result(), simplified);
+    this->merged = intern_ast(simplified, this->ast);
+    this->prog = compile_ast(this->ast);
+}
+
+
+size_t Formula::slot(const string &name) const {
+    auto it = this->ast.var_slots.find(name);
+    return it == this->ast.var_slots.end() ? NO_SLOT : it->second;
+}
+
+
+Value Formula::eval(const vector<Value> &vars, VM &vm) const {
+    if (vars.size() < this->var_count()) {
+        throw ArgumentError(
+            "expected " + to_string(this->var_count()) + " variables"
+                + ", got " + to_string(vars.size()) + "\n"
+        );
+    }
+    return vm.run(this->prog, vars.data());
+}
@@ -0,0 +1,80 @@
+#ifndef CALCXX_FORMULA_H
+#define CALCXX_FORMULA_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ast.h"
+#include "bytecode.h"
+#include "value.h"
+
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+
+/*
+ * An expression parsed and compiled once, then evaluated with new variable
+ * values as many times as needed. Variables are resolved to dense slots at
+ * compile time, in order of first appearance, so evaluation only indexes
+ * the bound values. Repeated subexpressions are merged by intern_ast() and
+ * evaluated once per eval().
+ *
+ *     Formula f("price * (1 + rate)");
+ *     vector<Value> vars(f.var_count());
+ *     vars[f.slot("price")] = Value::of_int(100);
+ *     vars[f.slot("rate")] = Value::of_float(0.2);
+ *     VM vm;
+ *     f.eval(vars, vm);   // 120.0
+ *
+ * eval() is const, a Formula can be shared between threads each with their own VM.
+ */
+class Formula {
+public:
+    static const size_t NO_SLOT = SIZE_MAX;
+
+    // throws TokenizerError or ParserError
+    explicit Formula(string_view text);
+
+    size_t var_count() const {
+        return this->ast.var_names.size();
+    }
+
+    // indexed by slot
+    const vector<string> &var_names() const {
+        return this->ast.var_names;
+    }
+
+    // NO_SLOT if the formula does not use name
+    size_t slot(const string &name) const;
+
+    // vars[slot] is the value of each variable, throws ArgumentError if vars is too short
+    Value eval(const vector<Value> &vars, VM &vm) const;
+
+    // the simplified and interned AST the program is compiled from
+    const Ast &get_ast() const {
+        return this->ast;
+    }
+
+    // the number of nodes intern_ast() merged into an equal subtree
+    size_t merged_nodes() const {
+        return this->merged;
+    }
+
+    const Program &get_program() const {
+        return this->prog;
+    }
+
+private:
+    Ast ast;
+    Program prog;
+    size_t merged = 0;
+};
+
+
+#endif //CALCXX_FORMULA_H
@@ -0,0 +1,151 @@
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "formula_cache.h"
+
+
+using std::deque;
+using std::hash;
+using std::make_shared;
+using std::memory_order_relaxed;
+using std::shared_lock;
+using std::unique_lock;
+
+
+const size_t FormulaCache::SHARD_COUNT;
+
+
+// aligned so that shards used by different threads do not share cache lines
+struct alignas(64) FormulaCache::Shard {
+    struct Entry {
+        string text;
+        shared_ptr<const Formula> formula;
+        atomic<bool> referenced{false};
+    };
+
+    mutable shared_mutex mtx;
+    deque<Entry> entries;   // grown up to capacity, appending never moves the texts
+    size_t capacity = 0;
+    size_t hand = 0;
+    unordered_map<string_view, size_t> index;   // views of the texts of entries
+
+    atomic<size_t> hits{0};
+    atomic<size_t> misses{0};
+    size_t evictions = 0;
+
+    // call with mtx held, shared or not
+    shared_ptr<const Formula> find_locked(string_view text) {
+        auto it = this->index.find(text);
+        if (it == this->index.end()) {
+            return nullptr;
+        }
+        Entry &entry = this->entries[it->second];
+        entry.referenced.store(true, memory_order_relaxed);
+        return entry.formula;
+    }
+
+    // call with mtx held exclusively, text must not be cached
+    void insert_locked(string_view text, const shared_ptr<const Formula> &formula) {
+        size_t slot;
+        if (this->entries.size() < this->capacity) {
+            slot = this->entries.size();
+            this->entries.emplace_back();
+        } else {
+            while (this->entries[this->hand].referenced.exchange(false, memory_order_relaxed)) {
+                this->hand = (this->hand + 1) % this->capacity;
+            }
+            slot = this->hand;
+            this->hand = (this->hand + 1) % this->capacity;
+            this->index.erase(this->entries[slot].text);
+            this->evictions++;
+        }
+
+        Entry &entry = this->entries[slot];
+        entry.text.assign(text.data(), text.size());
+        entry.formula = formula;
+        entry.referenced.store(false, memory_order_relaxed);
+        this->index.emplace(entry.text, slot);
+    }
+};
+
+
+FormulaCache::FormulaCache(size_t capacity) : shards(new Shard[SHARD_COUNT]) {
+    size_t per_shard = capacity / SHARD_COUNT + (capacity % SHARD_COUNT != 0);
+    if (per_shard == 0) {
+        per_shard = 1;
+    }
+    for (size_t i = 0; i < SHARD_COUNT; i++) {
+        this->shards[i].capacity = per_shard;
+    }
+}
+
+
+FormulaCache::~FormulaCache() = default;
+
+
+FormulaCache::Shard &FormulaCache::shard_of(string_view text) const {
+    size_t h = hash<string_view>()(text);
+    return this->shards[(h >> 32 ^ h) % SHARD_COUNT];
+}
+
+
+shared_ptr<const Formula> FormulaCache::get(string_view text) {
+    Shard &shard = this->shard_of(text);
+    {
+        shared_lock<shared_mutex> lock(shard.mtx);
+        shared_ptr<const Formula> formula = shard.find_locked(text);
+        if (formula) {
+            shard.hits.fetch_add(1, memory_order_relaxed);
+            return formula;
+        }
+    }
+    shard.misses.fetch_add(1, memory_order_relaxed);
+
+    // compiled without the lock, another thread may add the same text meanwhile
+    shared_ptr<const Formula> formula = make_shared<const Formula>(text);
+    unique_lock<shared_mutex> lock(shard.mtx);
+    shared_ptr<const Formula> cached = shard.find_locked(text);
+    if (cached) {
+        return cached;
+    }
+    shard.insert_locked(text, formula);
+    return formula;
+}
+
+
+shared_ptr<const Formula> FormulaCache::find(string_view text) {
+    Shard &shard = this->shard_of(text);
+    shared_lock<shared_mutex> lock(shard.mtx);
+    shared_ptr<const Formula> formula = shard.find_locked(text);
+    (formula ? shard.hits : shard.misses).fetch_add(1, memory_order_relaxed);
+    return formula;
+}
+
+
+FormulaCache::Stats FormulaCache::stats() const {
+    Stats ans;
+    for (size_t i = 0; i < SHARD_COUNT; i++) {
+        const Shard &shard = this->shards[i];
+        shared_lock<shared_mutex> lock(shard.mtx);
+        ans.hits += shard.hits.load(memory_order_relaxed);
+        ans.misses += shard.misses.load(memory_order_relaxed);
+        ans.evictions += shard.evictions;
+        ans.size += shard.entries.size();
+    }
+    return ans;
+}
+
+
+void FormulaCache::clear() {
+    for (size_t i = 0; i < SHARD_COUNT; i++) {
+        Shard &shard = this->shards[i];
+        unique_lock<shared_mutex> lock(shard.mtx);
+        shard.index.clear();
+        shard.entries.clear();
+        shard.hand = 0;
+        shard.hits.store(0, memory_order_relaxed);
+        shard.misses.store(0, memory_order_relaxed);
+        shard.evictions = 0;
+    }
+}
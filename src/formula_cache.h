@@ -0,0 +1,75 @@
+#ifndef CALCXX_FORMULA_CACHE_H
+#define CALCXX_FORMULA_CACHE_H
+
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "formula.h"
+
+
+using std::atomic;
+using std::shared_mutex;
+using std::shared_ptr;
+using std::string;
+using std::string_view;
+using std::unique_ptr;
+using std::unordered_map;
+
+
+/*
+ * Compiled Formulas by expression text, shared between threads, so a formula
+ * submitted again skips tokenizing, parsing, simplifying and compiling.
+ *
+ * Texts are spread over SHARD_COUNT shards by hash, each with its own lock and
+ * its share of the capacity. Lookups take the lock of their shard shared, so
+ * concurrent readers only contend on writes to the same shard. When a shard
+ * is full, CLOCK eviction picks the entry to replace as in ResultCache, the
+ * reference bits are atomic so hits can set them under the shared lock.
+ *
+ * A Formula stays valid while the caller holds it, even after its entry is
+ * evicted or the cache is cleared.
+ */
+class FormulaCache {
+public:
+    static const size_t SHARD_COUNT = 16;
+
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t size = 0;
+    };
+
+    // holds at most about capacity formulas, at least one per shard,
+    // memory is only taken as formulas are added
+    explicit FormulaCache(size_t capacity);
+    ~FormulaCache();
+
+    FormulaCache(const FormulaCache &) = delete;
+    FormulaCache &operator=(const FormulaCache &) = delete;
+
+    // the Formula of text, compiled and added on a miss,
+    // throws TokenizerError or ParserError, which are not cached
+    shared_ptr<const Formula> get(string_view text);
+    // the Formula of text or null, without compiling
+    shared_ptr<const Formula> find(string_view text);
+
+    Stats stats() const;
+    void clear();
+
+private:
+    struct Shard;
+
+    unique_ptr<Shard[]> shards;
+
+    Shard &shard_of(string_view text) const;
+};
+
+
+#endif //CALCXX_FORMULA_CACHE_H
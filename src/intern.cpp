@@ -0,0 +1,126 @@
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "intern.h"
+
+
+using std::hash;
+using std::memcpy;
+using std::string;
+using std::unordered_set;
+using std::vector;
+
+
+static uint64_t mix(uint64_t h, uint64_t x) {
+    h ^= x + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2);
+    return h;
+}
+
+
+static uint64_t value_bits(const Value &value) {
+    uint64_t bits;
+    memcpy(&bits, &value.ival, sizeof(bits));
+    return bits;
+}
+
+
+// nodes of the DAG being built, looked up by id, children are equal
+// subtrees only if they are the same node
+struct NodeHash {
+    const Ast *ast;
+
+    size_t operator()(NodeId id) const {
+        const AstNode &node = (*this->ast)[id];
+        uint64_t h = mix(static_cast<uint64_t>(node.type), node.nchildren);
+        if (node.type == TokenType::NAME) {
+            return mix(h, node.slot);
+        }
+        for (size_t i = 0; i < node.nchildren; i++) {
+            h = mix(h, node.children[i]);
+        }
+        if (node.is_value()) {
+            if (node.value.type == ValueType::BIG) {
+                return mix(h, hash<string>()(node.value.big_value().to_string()));
+            }
+            return mix(h, value_bits(node.value));
+        }
+        return h;
+    }
+};
+
+
+struct NodeEqual {
+    const Ast *ast;
+
+    bool operator()(NodeId id1, NodeId id2) const {
+        const AstNode &node1 = (*this->ast)[id1];
+        const AstNode &node2 = (*this->ast)[id2];
+        if (node1.type != node2.type || node1.nchildren != node2.nchildren) {
+            return false;
+        }
+        if (node1.type == TokenType::NAME) {
+            return node1.slot == node2.slot;
+        }
+        for (size_t i = 0; i < node1.nchildren; i++) {
+            if (node1.children[i] != node2.children[i]) {
+                return false;
+            }
+        }
+        if (node1.is_value()) {
+            if (node1.value.type == ValueType::BIG) {
+                return node1.value == node2.value;
+            }
+            return value_bits(node1.value) == value_bits(node2.value);
+        }
+        return true;
+    }
+};
+
+
+size_t intern_ast(const Ast &src, Ast &dst) {
+    assert(&src != &dst);
+    dst.clear();
+    dst.var_names = src.var_names;
+    dst.var_slots = src.var_slots;
+    if (src.empty()) {
+        return 0;
+    }
+
+    // the node of dst for each node of src, src may already be a DAG
+    vector<NodeId> copies(src.nodes.size(), NO_NODE);
+    unordered_set<NodeId, NodeHash, NodeEqual> table(
+        src.nodes.size(), NodeHash{&dst}, NodeEqual{&dst});
+    size_t merged = 0;
+
+    vector<AstWalkItem> stack;
+    walk_ast(
+        src, src.root, stack,
+        [&](NodeId id, const AstNode &) {
+            return copies[id] == NO_NODE;
+        },
+        [&](NodeId id, const AstNode &node) {
+            if (copies[id] != NO_NODE) {
+                return;
+            }
+            AstNode copy = node;
+            for (size_t i = 0; i < node.nchildren; i++) {
+                copy.children[i] = copies[node.children[i]];
+            }
+            dst.nodes.push_back(copy);
+
+            auto inserted = table.insert(static_cast<NodeId>(dst.nodes.size() - 1));
+            if (!inserted.second) {
+                dst.nodes.pop_back();
+                merged++;
+            }
+            copies[id] = *inserted.first;
+        });
+
+    dst.root = copies[src.root];
+    return merged;
+}
@@ -0,0 +1,25 @@
+#ifndef CALCXX_INTERN_H
+#define CALCXX_INTERN_H
+
+
+#include <cstddef>
+
+#include "ast.h"
+
+
+/*
+ * Hash-consing: writes to dst a copy of src where structurally equal subtrees
+ * are one node shared by all their parents, so dst == src still holds.
+ * Each node is looked up in a hash table of the nodes already written, and
+ * since its children were interned first, comparing them is comparing ids,
+ * which makes the pass linear in the size of src. Nodes are written children
+ * first, as the parser does. Int and float values are only equal with the
+ * same bits, so 0.0 and -0.0 stay apart.
+ *
+ * Returns the number of nodes of src that were merged into an equal one.
+ * compile_ast() evaluates the shared nodes once per run.
+ */
+size_t intern_ast(const Ast &src, Ast &dst);
+
+
+#endif //CALCXX_INTERN_H
@@ -0,0 +1,536 @@
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "eval_ast.h"
+#include "exception.h"
+#include "jit.h"
+#include "operators.h"
+
+
+using std::memcpy;
+using std::numeric_limits;
+using std::to_string;
+
+
+const size_t JitExpr::MAX_NODES;
+
+
+enum Reg : uint8_t {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+enum Cond : uint8_t {
+    COND_O = 0x0,
+    COND_E = 0x4,
+    COND_NE = 0x5,
+    COND_P = 0xA,
+};
+
+
+// the value at depth d of the evaluation lives in INT_REGS[d] or in xmm d,
+// xmm 15 is left for temporaries, rsi is saved on entry, rdi keeps the vars
+// pointer, rax and rdx are left for idiv
+static const Reg INT_REGS[] = {RCX, RSI, R8, R9, R10, R11};
+static const size_t INT_REG_COUNT = sizeof(INT_REGS) / sizeof(INT_REGS[0]);
+static const size_t FLOAT_REG_COUNT = 15;
+static const uint8_t XTMP = 15;
+
+static const int32_t TYPE_OFFSET = offsetof(Value, type);
+static const int32_t DATA_OFFSET = offsetof(Value, ival);
+
+
+/*
+ * Encodes the few instructions the code generator needs.
+ * Memory operands are always [base + disp32].
+ */
+class Assembler {
+public:
+    vector<uint8_t> code;
+
+    void byte(uint8_t b) {
+        this->code.push_back(b);
+    }
+
+    void imm32(uint32_t v) {
+        for (int i = 0; i < 4; i++) {
+            this->byte(uint8_t(v >> (8 * i)));
+        }
+    }
+
+    void imm64(uint64_t v) {
+        for (int i = 0; i < 8; i++) {
+            this->byte(uint8_t(v >> (8 * i)));
+        }
+    }
+
+    // mov dst, imm64
+    void mov_imm(Reg dst, uint64_t v) {
+        this->rex(true, 0, dst);
+        this->byte(0xB8 + (dst & 7));
+        this->imm64(v);
+    }
+
+    // mov dst, src
+    void mov(Reg dst, Reg src) {
+        this->rex(true, src, dst);
+        this->byte(0x89);
+        this->modrm(src, dst);
+    }
+
+    // mov dst, [base + disp]
+    void load(Reg dst, Reg base, int32_t disp) {
+        this->rex(true, dst, base);
+        this->byte(0x8B);
+        this->modrm_mem(dst, base, disp);
+    }
+
+    // mov [base + disp], src
+    void store(Reg base, int32_t disp, Reg src) {
+        this->rex(true, src, base);
+        this->byte(0x89);
+        this->modrm_mem(src, base, disp);
+    }
+
+    // mov byte [base + disp], v
+    void store_byte(Reg base, int32_t disp, uint8_t v) {
+        this->rex(false, 0, base);
+        this->byte(0xC6);
+        this->modrm_mem(0, base, disp);
+        this->byte(v);
+    }
+
+    // cmp byte [base + disp], v
+    void cmp_byte(Reg base, int32_t disp, uint8_t v) {
+        this->rex(false, 0, base);
+        this->byte(0x80);
+        this->modrm_mem(7, base, disp);
+        this->byte(v);
+    }
+
+    // cmp r, v
+    void cmp_imm8(Reg r, int8_t v) {
+        this->rex(true, 0, r);
+        this->byte(0x83);
+        this->modrm(7, r);
+        this->byte(uint8_t(v));
+    }
+
+    // dst += src
+    void add(Reg dst, Reg src) {
+        this->rex(true, src, dst);
+        this->byte(0x01);
+        this->modrm(src, dst);
+    }
+
+    // dst -= src
+    void sub(Reg dst, Reg src) {
+        this->rex(true, src, dst);
+        this->byte(0x29);
+        this->modrm(src, dst);
+    }
+
+    // dst *= src
+    void imul(Reg dst, Reg src) {
+        this->rex(true, dst, src);
+        this->byte(0x0F);
+        this->byte(0xAF);
+        this->modrm(dst, src);
+    }
+
+    // r = -r
+    void neg(Reg r) {
+        this->rex(true, 0, r);
+        this->byte(0xF7);
+        this->modrm(3, r);
+    }
+
+    // test a, b
+    void test(Reg a, Reg b) {
+        this->rex(true, b, a);
+        this->byte(0x85);
+        this->modrm(b, a);
+    }
+
+    // rdx:rax = sign extension of rax, then rax, rdx = rdx:rax / r, rdx:rax % r
+    void cqo_idiv(Reg r) {
+        this->byte(0x48);
+        this->byte(0x99);
+        this->rex(true, 0, r);
+        this->byte(0xF7);
+        this->modrm(7, r);
+    }
+
+    void push(Reg r) {
+        this->rex(false, 0, r);
+        this->byte(0x50 + (r & 7));
+    }
+
+    void pop(Reg r) {
+        this->rex(false, 0, r);
+        this->byte(0x58 + (r & 7));
+    }
+
+    // eax = v, then ret
+    void ret_int32(uint32_t v) {
+        this->byte(0xB8);
+        this->imm32(v);
+        this->byte(0xC3);
+    }
+
+    // movq xmm, r
+    void movq(uint8_t xmm, Reg r) {
+        this->sse(0x66, true, 0x6E, xmm, r);
+    }
+
+    // movsd xmm, [base + disp]
+    void load_sd(uint8_t xmm, Reg base, int32_t disp) {
+        this->byte(0xF2);
+        this->rex(false, xmm, base);
+        this->byte(0x0F);
+        this->byte(0x10);
+        this->modrm_mem(xmm, base, disp);
+    }
+
+    // movsd [base + disp], xmm
+    void store_sd(Reg base, int32_t disp, uint8_t xmm) {
+        this->byte(0xF2);
+        this->rex(false, xmm, base);
+        this->byte(0x0F);
+        this->byte(0x11);
+        this->modrm_mem(xmm, base, disp);
+    }
+
+    void movapd(uint8_t dst, uint8_t src) {
+        this->sse(0x66, false, 0x28, dst, src);
+    }
+
+    void xorpd(uint8_t dst, uint8_t src) {
+        this->sse(0x66, false, 0x57, dst, src);
+    }
+
+    void ucomisd(uint8_t a, uint8_t b) {
+        this->sse(0x66, false, 0x2E, a, b);
+    }
+
+    void cvtsi2sd(uint8_t dst, Reg src) {
+        this->sse(0xF2, true, 0x2A, dst, src);
+    }
+
+    // addsd, subsd, mulsd or divsd
+    void arith_sd(OpCode op, uint8_t dst, uint8_t src) {
+        static const uint8_t opcodes[OPCODE_COUNT] = {0, 0, 0x58, 0x5C, 0x59, 0x5E};
+        assert(opcodes[static_cast<size_t>(op)] != 0);
+        this->sse(0xF2, false, opcodes[static_cast<size_t>(op)], dst, src);
+    }
+
+    // returns the position to pass to bind()
+    size_t jcc(Cond cc) {
+        this->byte(0x0F);
+        this->byte(0x80 + cc);
+        this->imm32(0);
+        return this->code.size();
+    }
+
+    size_t jmp() {
+        this->byte(0xE9);
+        this->imm32(0);
+        return this->code.size();
+    }
+
+    // the jump ending at fixup goes to the current position
+    void bind(size_t fixup) {
+        uint32_t rel = uint32_t(this->code.size() - fixup);
+        memcpy(&this->code[fixup - 4], &rel, 4);
+    }
+
+private:
+    // omitted when it would be a plain 0x40
+    void rex(bool wide, uint8_t reg, uint8_t rm) {
+        uint8_t prefix = 0x40 | (wide << 3) | ((reg >> 3) << 2) | (rm >> 3);
+        if (prefix != 0x40) {
+            this->byte(prefix);
+        }
+    }
+
+    void modrm(uint8_t reg, uint8_t rm) {
+        this->byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+    }
+
+    void modrm_mem(uint8_t reg, Reg base, int32_t disp) {
+        this->byte(0x80 | ((reg & 7) << 3) | (base & 7));
+        if ((base & 7) == RSP) {
+            this->byte(0x24);   // SIB without index
+        }
+        this->imm32(uint32_t(disp));
+    }
+
+    void sse(uint8_t prefix, bool wide, uint8_t op, uint8_t reg, uint8_t rm) {
+        this->byte(prefix);
+        this->rex(wide, reg, rm);
+        this->byte(0x0F);
+        this->byte(op);
+        this->modrm(reg, rm);
+    }
+};
+
+
+struct CodeGen {
+    const Ast &ast;
+    const vector<ValueType> &var_types;
+    Assembler as;
+    vector<size_t> bail_jumps;  // to the exit returning false
+
+    void bail_if(Cond cc) {
+        this->bail_jumps.push_back(this->as.jcc(cc));
+    }
+};
+
+
+// BIG values are never compiled
+static bool has_register(ValueType type, size_t depth) {
+    if (type == ValueType::BIG) {
+        return false;
+    }
+    return depth < (type == ValueType::INT ? INT_REG_COUNT : FLOAT_REG_COUNT);
+}
+
+
+// xmm dst = dst op src, with the division by zero of div_float()
+static void gen_float_op(CodeGen &gen, OpCode op, uint8_t dst, uint8_t src) {
+    Assembler &as = gen.as;
+    if (op != OpCode::DIV) {
+        as.arith_sd(op, dst, src);
+        return;
+    }
+
+    assert(src != XTMP);
+    as.xorpd(XTMP, XTMP);
+    as.ucomisd(src, XTMP);
+    size_t unordered = as.jcc(COND_P);
+    size_t nonzero = as.jcc(COND_NE);
+    double inf = numeric_limits<double>::infinity();
+    uint64_t bits;
+    memcpy(&bits, &inf, sizeof(bits));
+    as.mov_imm(RAX, bits);
+    as.movq(dst, RAX);
+    size_t done = as.jmp();
+    as.bind(unordered);
+    as.bind(nonzero);
+    as.arith_sd(op, dst, src);
+    as.bind(done);
+}
+
+
+// dst = dst op src in int64 like kernel_ii(), the code bails out if it
+// overflows, or for the division if it is not exact
+static void gen_int_op(CodeGen &gen, OpCode op, Reg dst, Reg src) {
+    Assembler &as = gen.as;
+    switch (op) {
+    case OpCode::ADD:
+        as.add(dst, src);
+        break;
+    case OpCode::SUB:
+        as.sub(dst, src);
+        break;
+    case OpCode::MULT:
+        as.imul(dst, src);
+        break;
+    case OpCode::DIV: {
+        as.test(src, src);
+        gen.bail_if(COND_E);
+        // idiv traps on INT64_MIN / -1
+        as.cmp_imm8(src, -1);
+        size_t not_minus_one = as.jcc(COND_NE);
+        as.neg(dst);
+        gen.bail_if(COND_O);
+        size_t done = as.jmp();
+        as.bind(not_minus_one);
+        as.mov(RAX, dst);
+        as.cqo_idiv(src);
+        as.test(RDX, RDX);
+        gen.bail_if(COND_NE);
+        as.mov(dst, RAX);
+        as.bind(done);
+        return;
+    }
+    default:
+        assert(!"Unreachable");
+    }
+    gen.bail_if(COND_O);
+}
+
+
+// unary operators are their binary form with a zero on the left
+static OpCode unary_as_binary(OpCode op) {
+    return op == OpCode::POS ? OpCode::ADD : OpCode::SUB;
+}
+
+
+// emits code leaving the value of node id in the registers of depth,
+// returns false if the node is not supported
+static bool gen_node(CodeGen &gen, NodeId id, size_t depth, ValueType &type) {
+    Assembler &as = gen.as;
+    const AstNode &node = gen.ast[id];
+
+    if (node.type == TokenType::NAME) {
+        type = gen.var_types[node.slot];
+        if (!has_register(type, depth)) {
+            return false;
+        }
+        int32_t disp = int32_t(node.slot * sizeof(Value)) + DATA_OFFSET;
+        if (type == ValueType::INT) {
+            as.load(INT_REGS[depth], RDI, disp);
+        } else {
+            as.load_sd(uint8_t(depth), RDI, disp);
+        }
+        return true;
+    }
+    if (node.is_value()) {
+        type = node.value.type;
+        if (!has_register(type, depth)) {
+            return false;
+        }
+        if (type == ValueType::INT) {
+            as.mov_imm(INT_REGS[depth], uint64_t(node.value.ival));
+        } else {
+            uint64_t bits;
+            memcpy(&bits, &node.value.fval, sizeof(bits));
+            as.mov_imm(RAX, bits);
+            as.movq(uint8_t(depth), RAX);
+        }
+        return true;
+    }
+    if (node.op == OpCode::COUNT) {
+        return false;
+    }
+
+    if (node.nchildren == 1) {
+        if (!gen_node(gen, node.children[0], depth, type)) {
+            return false;
+        }
+        if (type == ValueType::INT) {
+            if (node.op == OpCode::NEG) {
+                as.neg(INT_REGS[depth]);
+                gen.bail_if(COND_O);
+            }
+        } else {
+            OpCode op = unary_as_binary(node.op);
+            uint8_t x = uint8_t(depth);
+            as.movapd(XTMP, x);
+            as.xorpd(x, x);
+            as.arith_sd(op, x, XTMP);
+        }
+        return true;
+    }
+
+    ValueType lhs, rhs;
+    if (!gen_node(gen, node.children[0], depth, lhs)
+        || !gen_node(gen, node.children[1], depth + 1, rhs))
+    {
+        return false;
+    }
+    if (lhs == ValueType::INT && rhs == ValueType::INT) {
+        gen_int_op(gen, node.op, INT_REGS[depth], INT_REGS[depth + 1]);
+        type = ValueType::INT;
+        return true;
+    }
+
+    if (lhs == ValueType::INT) {
+        as.cvtsi2sd(uint8_t(depth), INT_REGS[depth]);
+    }
+    if (rhs == ValueType::INT) {
+        as.cvtsi2sd(uint8_t(depth + 1), INT_REGS[depth + 1]);
+    }
+    gen_float_op(gen, node.op, uint8_t(depth), uint8_t(depth + 1));
+    type = ValueType::FLOAT;
+    return true;
+}
+
+
+// the code of JitFunc for ast, false if it is not supported
+static bool gen_function(CodeGen &gen) {
+    Assembler &as = gen.as;
+    as.push(RSI);
+    for (size_t slot = 0; slot < gen.ast.var_names.size(); slot++) {
+        as.cmp_byte(
+            RDI, int32_t(slot * sizeof(Value)) + TYPE_OFFSET,
+            static_cast<uint8_t>(gen.var_types[slot]));
+        gen.bail_if(COND_NE);
+    }
+
+    ValueType type;
+    if (!gen_node(gen, gen.ast.root, 0, type)) {
+        return false;
+    }
+    as.pop(RSI);
+    as.store_byte(RSI, TYPE_OFFSET, static_cast<uint8_t>(type));
+    if (type == ValueType::INT) {
+        as.store(RSI, DATA_OFFSET, INT_REGS[0]);
+    } else {
+        as.store_sd(RSI, DATA_OFFSET, 0);
+    }
+    as.ret_int32(1);
+
+    for (size_t fixup : gen.bail_jumps) {
+        as.bind(fixup);
+    }
+    as.pop(RSI);
+    as.ret_int32(0);
+    return true;
+}
+
+
+JitExpr::JitExpr(const Ast &ast, const vector<ValueType> &var_types) : ast(ast) {
+    if (var_types.size() < ast.var_names.size()) {
+        throw ArgumentError(
+            "expected " + to_string(ast.var_names.size()) + " variable types"
+                + ", got " + to_string(var_types.size()) + "\n"
+        );
+    }
+
+#if defined(__x86_64__)
+    CodeGen gen = {this->ast, var_types, Assembler(), {}};
+    if (this->ast.empty() || this->ast.nodes.size() > MAX_NODES || !gen_function(gen)) {
+        return;
+    }
+
+    size_t page = size_t(sysconf(_SC_PAGESIZE));
+    size_t size = (gen.as.code.size() + page - 1) / page * page;
+    void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        return;
+    }
+    memcpy(addr, gen.as.code.data(), gen.as.code.size());
+    // never writable and executable at the same time
+    if (mprotect(addr, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(addr, size);
+        return;
+    }
+    this->code = addr;
+    this->code_size = size;
+    this->func = reinterpret_cast<JitFunc>(addr);
+#endif
+}
+
+
+JitExpr::~JitExpr() {
+    if (this->code) {
+        munmap(this->code, this->code_size);
+    }
+}
+
+
+Value JitExpr::eval(const Value *vars) const {
+    Value result;
+    if (this->func && (vars || this->ast.var_names.empty()) && this->func(vars, &result)) {
+        return result;
+    }
+    return eval_ast(this->ast, vars);
+}
@@ -0,0 +1,64 @@
+#ifndef CALCXX_JIT_H
+#define CALCXX_JIT_H
+
+
+#include <cstddef>
+#include <vector>
+
+#include "ast.h"
+#include "value.h"
+
+
+using std::vector;
+
+
+// writes the value of the expression to *result, which must not be BIG, and returns
+// true, or returns false if the caller has to evaluate it with the interpreter
+typedef bool (*JitFunc)(const Value *vars, Value *result);
+
+
+/*
+ * Native x86-64 code for an AST, in its own executable page.
+ *
+ * The code is specialized to the types of the variables it was compiled for,
+ * every value gets a static type and lives in a register: int64 in general
+ * purpose registers and double in SSE2 registers. It computes the same bits as
+ * the kernels in operators.cpp. Where the type of a result depends on the
+ * values, as for int arithmetic that may overflow to BIG or the division of two
+ * ints, the code assumes the int case and checks it at run time. A variable of
+ * another type or a failed check makes the function return false.
+ *
+ * ASTs with unsupported operators, BIG values, more nested values than
+ * registers or more than MAX_NODES nodes are not compiled, function() is null
+ * and eval() always uses the interpreter. The code generator recurses on the
+ * tree, MAX_NODES bounds its depth.
+ */
+class JitExpr {
+public:
+    static const size_t MAX_NODES = 1024;
+
+    // var_types[slot] is the assumed type of each variable of ast,
+    // throws ArgumentError if var_types is too short
+    explicit JitExpr(const Ast &ast, const vector<ValueType> &var_types = {});
+    ~JitExpr();
+
+    JitExpr(const JitExpr &) = delete;
+    JitExpr &operator=(const JitExpr &) = delete;
+
+    // null if the AST could not be compiled
+    JitFunc function() const {
+        return this->func;
+    }
+
+    // runs the native code, falls back to eval_ast() when it returns false
+    Value eval(const Value *vars = nullptr) const;
+
+private:
+    Ast ast;
+    void *code = nullptr;
+    size_t code_size = 0;
+    JitFunc func = nullptr;
+};
+
+
+#endif //CALCXX_JIT_H
@@ -1,25 +1,35 @@
+#include <algorithm>
 #include <cassert>
-#include <exception>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <unistd.h>
 
-#include "eval.h"
-#include "eval_ast.h"
+#include "batch.h"
+#include "calculator.h"
 #include "exception.h"
-#include "node.h"
-#include "parser.h"
+#include "server.h"
 #include "sourcepos.h"
-#include "tokenizer.h"
-#include "tokens.h"
+#include "stats.h"
+#include "value.h"
 
 
 using std::cin;
 using std::cout;
 using std::cerr;
 using std::endl;
-using std::exception;
 using std::getline;
+using std::max;
+using std::min;
 using std::string;
+using std::strtoul;
+using std::thread;
 using std::to_string;
 
 
@@ -35,88 +45,213 @@ static void report_error(
 }
 
 
-class AstEvaluator {
-public:
-    AstEvaluator() {}
+// the :stats command prints the stats of the session, which are always collected,
+// every line is timed since a prompt is far slower than reading the clock
+static void main_func(EvalMode mode, size_t cache_size) {
+    Calculator calc(mode, cache_size);
+    enable_stats(true, 1);
 
-    void feed(const Token::Ptr &tok) {
-        this->parser.feed(tok);
-    }
+    for (int count = 0; !cin.eof(); count++) {
+        string prompt = "[" + to_string(count) + "] ";
+        string line;
 
-    Token::Ptr get_result() {
-        Node::Ptr ast = this->parser.get_result();
-        return eval_node(ast);
+        cout << prompt;
+        getline(cin, line);
+        if (line == ":stats") {
+            cout << repr_stats(collect_stats());
+            if (cache_size > 0) {
+                cout << "result cache " << calc.result_cache().hits() << " hits "
+                    << calc.result_cache().misses() << " misses" << endl;
+            }
+            continue;
+        }
+        LineResult result = calc.eval_line(line);
+        if (result.status == LineStatus::ok) {
+            cout << repr(result.value) << endl;
+        } else if (result.status == LineStatus::error) {
+            report_error(result.error, result.start, result.end, prompt.size());
+        }
     }
+}
+
 
-    void reset() {
-        this->parser = Parser();
+// prints the AST of each line on stdin before and after simplify_ast()
+static int dump_ast_func() {
+    Calculator calc;
+    string line, out, err;
+    size_t failed = 0;
+
+    for (size_t lineno = 1; getline(cin, line); lineno++) {
+        err.clear();
+        LineResult result = calc.dump_line(line, out);
+        append_line_result(out, err, result, lineno);
+        cout << out;
+        cerr << err;
+        failed += result.status == LineStatus::error;
     }
+    return failed > 0 ? 1 : 0;
+}
 
-private:
-    Parser parser;
-};
 
+static Server *g_server = nullptr;
 
-template<class EvaluatorType>
-void main_func() {
-    Tokenizer tokenizer;
-    EvaluatorType evaluator;
 
-    for (int count = 0; !cin.eof(); count++) {
-        string prompt = "[" + to_string(count) + "] ";
-        string line;
+static void stop_server(int) {
+    g_server->stop();
+}
 
-        cout << prompt;
-        getline(cin, line);
-        for (size_t i = 0; i <= line.size(); i++) {
-            try {
-                tokenizer.feed(line[i]);
-            } catch (const TokenizerError &exc) {
-                // report
-                SourcePos pos = SourcePos(0, (int)i);
-                const string msg = string("TokenizerError: ") + exc.what();
-                report_error(msg, pos, pos, prompt.size());
-                goto CLEAN_UP;
-            }
 
-            Token::Ptr tok;
-            while ((tok = tokenizer.pop())) {
-                try {
-                    evaluator.feed(tok);
-                    if (tok->type == TokenType::END) {
-                        Token::Ptr result = evaluator.get_result();
-                        cout << result->_repr_value() << endl;
-                        // cout << repr(*evaluator.get_result()) << endl;
-                    }
-                } catch (const EvalError &exc) {
-                    const string msg = string("EvalError: ") + exc.what();
-                    report_error(msg, tok->start, tok->end, prompt.size());
-                    goto CLEAN_UP;
-                } catch (const ParserError &exc) {
-                    const string msg = string("ParserError: ") + exc.what();
-                    report_error(msg, tok->start, tok->end, prompt.size());
-                    goto CLEAN_UP;
-                }
-            }
+// serves until SIGINT or SIGTERM
+static int serve_func(const ServerOptions &options) {
+    try {
+        Server server(options);
+        g_server = &server;
+        struct sigaction action = {};
+        action.sa_handler = stop_server;
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+
+        if (!options.unix_path.empty()) {
+            cerr << "listening on " << options.unix_path << endl;
+        }
+        if (server.tcp_port() >= 0) {
+            cerr << "listening on 127.0.0.1:" << server.tcp_port() << endl;
         }
+        server.run();
 
-    CLEAN_UP:
-        tokenizer.reset();
-        evaluator.reset();
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        g_server = nullptr;
+    } catch (const IOError &exc) {
+        cerr << exc.what() << endl;
+        return 1;
     }
+    return 0;
+}
+
+
+// threads beyond a few per cpu only add switching
+static const size_t MAX_THREADS_PER_CPU = 4;
+// entries of the ResultCache of each thread, each holds at least a line
+static const size_t MAX_CACHE_SIZE = size_t(1) << 26;
+
+
+// parses a decimal number from 0 to max, returns false for anything else
+static bool parse_number(const char *arg, unsigned long max_value, unsigned long &value) {
+    char *end;
+    errno = 0;
+    value = strtoul(arg, &end, 10);
+    return isdigit(static_cast<unsigned char>(arg[0])) && *end == '\0' && errno == 0
+        && value <= max_value;
+}
+
+
+static void usage(const char *prog) {
+    cerr << "usage: " << prog
+        << " [-p | -b | -t] [-i | --batch [FILE] | --dump-ast | --serve PATH] [--port N]"
+        << " [--threads N] [--cache N] [--stats]" << endl
+        << "  -p         evaluate the AST (default)" << endl
+        << "  -b         evaluate compiled bytecode" << endl
+        << "  -t         evaluate tokens directly" << endl
+        << "  -i         interactive prompt, the default when stdin is a terminal" << endl
+        << "  --batch    evaluate FILE or stdin line by line without prompts" << endl
+        << "  --dump-ast print the AST of each line on stdin before and after simplification" << endl
+        << "  --serve    answer the lines of clients of the Unix socket PATH, one per line" << endl
+        << "  --port N   serve on TCP port N (0 to 65535) of 127.0.0.1 too, or only without --serve" << endl
+        << "  --threads N  evaluate batches with N threads, 0 for one per cpu,"
+        << " at most " << MAX_THREADS_PER_CPU << " per cpu" << endl
+        << "  --cache N    reuse up to N cached results per thread, at most " << MAX_CACHE_SIZE
+        << ", a line takes up to two" << endl
+        << "  --stats    print phase latencies and operator counts to stderr at exit" << endl;
 }
 
 
 int main(int argc, const char *argv[]) {
-    string arg = "-p";
-    if (argc > 1) {
-        arg = string(argv[1]);
+    EvalMode mode = EvalMode::ast;
+    bool batch = !isatty(STDIN_FILENO);
+    bool dump_ast = false;
+    const char *filename = nullptr;
+    size_t threads = 1;
+    size_t cache_size = 0;
+    ServerOptions serve;
+    bool serving = false;
+    bool stats = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-p") {
+            mode = EvalMode::ast;
+        } else if (arg == "-b") {
+            mode = EvalMode::bytecode;
+        } else if (arg == "-t") {
+            mode = EvalMode::tokens;
+        } else if (arg == "-i") {
+            batch = false;
+        } else if (arg == "--batch") {
+            batch = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                filename = argv[++i];
+            }
+        } else if (arg == "--dump-ast") {
+            dump_ast = true;
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serving = true;
+            serve.unix_path = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            serving = true;
+            unsigned long value;
+            if (!parse_number(argv[++i], 65535, value)) {
+                usage(argv[0]);
+                return 2;
+            }
+            serve.tcp_port = int(value);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            unsigned long value;
+            if (!parse_number(argv[++i], ULONG_MAX, value)) {
+                usage(argv[0]);
+                return 2;
+            }
+            size_t cpus = max(thread::hardware_concurrency(), 1u);
+            threads = value == 0 ? cpus : min<size_t>(value, cpus * MAX_THREADS_PER_CPU);
+        } else if (arg == "--cache" && i + 1 < argc) {
+            unsigned long value;
+            if (!parse_number(argv[++i], MAX_CACHE_SIZE, value)) {
+                usage(argv[0]);
+                return 2;
+            }
+            cache_size = value;
+        } else if (arg == "--stats") {
+            stats = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
     }
 
-    if (arg == "-p") {
-        main_func<AstEvaluator>();
+    enable_stats(stats);
+    int status = 0;
+    if (dump_ast) {
+        status = dump_ast_func();
+    } else if (serving) {
+        serve.mode = mode;
+        serve.cache_size = cache_size;
+        serve.threads = threads;
+        status = serve_func(serve);
+    } else if (!batch) {
+        main_func(mode, cache_size);
+    } else if (filename) {
+        try {
+            status = run_batch_file(mode, filename, stdout, stderr, threads, cache_size) > 0;
+        } catch (const IOError &exc) {
+            cerr << exc.what() << endl;
+            status = 1;
+        }
     } else {
-        main_func<TokensEvaluator>();
+        status = run_batch(mode, stdin, stdout, stderr, threads, cache_size) > 0;
     }
-    return 0;
+
+    if (stats) {
+        cerr << repr_stats(collect_stats());
+    }
+    return status;
 }
@@ -0,0 +1,63 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+
+using std::strerror;
+
+
+static IOError io_error(const string &path, const char *reason) {
+    return IOError(path + ": " + reason);
+}
+
+
+MappedFile::MappedFile(const string &path) {
+    int fd = open(path.data(), O_RDONLY);
+    if (fd < 0) {
+        throw io_error(path, strerror(errno));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        IOError exc = io_error(path, strerror(errno));
+        close(fd);
+        throw exc;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        close(fd);
+        throw io_error(path, "not a regular file");
+    }
+
+    this->length = static_cast<size_t>(st.st_size);
+    if (this->length > 0) {
+        void *addr = mmap(nullptr, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            IOError exc = io_error(path, strerror(errno));
+            close(fd);
+            throw exc;
+        }
+        this->addr = static_cast<const char *>(addr);
+        madvise(addr, this->length, MADV_SEQUENTIAL);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (this->addr) {
+        munmap(const_cast<char *>(this->addr), this->length);
+    }
+}
+
+void MappedFile::release_before(size_t offset) {
+    static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t end = offset / page_size * page_size;
+    if (end > this->released) {
+        madvise(const_cast<char *>(this->addr + this->released), end - this->released, MADV_DONTNEED);
+        this->released = end;
+    }
+}
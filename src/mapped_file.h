@@ -0,0 +1,42 @@
+#ifndef CALCXX_MAPPED_FILE_H
+#define CALCXX_MAPPED_FILE_H
+
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "exception.h"
+
+
+using std::string;
+using std::string_view;
+
+
+/*
+ * A whole file mapped read-only into memory, for reading it once from start to end.
+ */
+class MappedFile {
+public:
+    // throws IOError if path can not be opened or mapped, e.g. it is a pipe
+    explicit MappedFile(const string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    string_view data() const {
+        return string_view(this->addr, this->length);
+    }
+
+    // the bytes before offset will not be read again, drop them from memory
+    void release_before(size_t offset);
+
+private:
+    const char *addr = nullptr;
+    size_t length = 0;
+    size_t released = 0;
+};
+
+
+#endif //CALCXX_MAPPED_FILE_H
@@ -1,21 +1,44 @@
+#include <utility>
+
 #include "node.h"
 
 
-bool Node::operator==(const Node &other) const {
-    if (*(this->token) != *other.token) {
-        return false;
-    }
-    if (this->children.size() != other.children.size()) {
-        return false;
+using std::move;
+using std::pair;
+
+
+// a child is detached from its subtree before it is freed, so freeing it
+// never recurses, and its children are freed by this loop
+Node::~Node() {
+    Container pending = move(this->children);
+    while (!pending.empty()) {
+        Ptr node = move(pending.back());
+        pending.pop_back();
+        if (node && node.use_count() == 1) {
+            for (Ptr &child : node->children) {
+                pending.push_back(move(child));
+            }
+            node->children.clear();
+        }
     }
-    for (
-        auto it1 = this->children.begin(), it2 = other.children.begin();
-        it1 != this->children.end();
-        ++it1, ++it2)
-    {
-        if (**it1 != **it2) {
+}
+
+
+bool Node::operator==(const Node &other) const {
+    vector<pair<const Node *, const Node *>> pending = {{this, &other}};
+    while (!pending.empty()) {
+        const Node &node1 = *pending.back().first;
+        const Node &node2 = *pending.back().second;
+        pending.pop_back();
+        if (*node1.token != *node2.token) {
             return false;
         }
+        if (node1.children.size() != node2.children.size()) {
+            return false;
+        }
+        for (size_t i = node1.children.size(); i-- > 0;) {
+            pending.emplace_back(node1.children[i].get(), node2.children[i].get());
+        }
     }
     return true;
 }
@@ -27,10 +50,16 @@ bool Node::operator!=(const Node &other) const {
 
 string repr_node(const Node &node, unsigned int indent) {
     string ans;
-    string pad = string(indent * 4, ' ');
-    ans += pad + node.token->_token_name() + " " + node.token->_repr_value() + "\n";
-    for (Node::Ptr child : node.children) {
-        ans += repr_node(*child, indent + 1);
+    vector<pair<const Node *, unsigned int>> pending = {{&node, indent}};
+    while (!pending.empty()) {
+        const Node &cur = *pending.back().first;
+        unsigned int level = pending.back().second;
+        pending.pop_back();
+        ans.append(level * 4, ' ');
+        ans += cur.token->_token_name() + " " + cur.token->_repr_value() + "\n";
+        for (size_t i = cur.children.size(); i-- > 0;) {
+            pending.emplace_back(cur.children[i].get(), level + 1);
+        }
     }
     return ans;
 }
@@ -23,6 +23,11 @@ struct Node {
     Container children;
 
     explicit Node(Token::Ptr tok) : token(tok) {}
+    // frees the subtrees only owned by this node without recursion
+    ~Node();
+    Node(const Node &) = default;
+    Node &operator=(const Node &) = default;
+
     bool operator==(const Node &other) const;
     bool operator!=(const Node &other) const;
 };
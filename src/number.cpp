@@ -0,0 +1,112 @@
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <system_error>
+
+#include "number.h"
+
+
+using std::chars_format;
+using std::errc;
+using std::from_chars;
+using std::from_chars_result;
+using std::make_shared;
+using std::numeric_limits;
+
+
+static inline bool is_digit(char ch) {
+    return ch >= '0' && ch <= '9';
+}
+
+
+static inline const char *skip_digits(const char *p, const char *end) {
+    while (p < end && is_digit(*p)) {
+        p++;
+    }
+    return p;
+}
+
+
+// saturates at a value far beyond any double exponent
+static int64_t parse_exp(const char *p, const char *end) {
+    const int64_t limit = numeric_limits<int32_t>::max();
+    int64_t ans = 0;
+    for (; p < end && ans < limit; p++) {
+        ans = ans * 10 + (*p - '0');
+    }
+    return ans;
+}
+
+
+// false if the integer does not fit in int64
+static bool parse_int(const char *p, const char *end, int64_t exp, int64_t &value) {
+    int64_t ans = 0;
+    for (; p < end; p++) {
+        if (__builtin_mul_overflow(ans, 10, &ans) || __builtin_add_overflow(ans, *p - '0', &ans)) {
+            return false;
+        }
+    }
+    for (; ans != 0 && exp > 0; exp--) {
+        if (__builtin_mul_overflow(ans, 10, &ans)) {
+            return false;
+        }
+    }
+    value = ans;
+    return true;
+}
+
+
+/*
+ * from_chars() leaves the value alone when it is out of range,
+ * pick infinity or zero from the decimal magnitude like strtod() does.
+ */
+static double out_of_range_value(const char *p, const char *int_end, const char *frac_end, int64_t exp) {
+    int64_t magnitude = 0;
+    const char *q = p;
+    while (q < int_end && *q == '0') {
+        q++;
+    }
+    if (q < int_end) {
+        magnitude = (int_end - q) + exp;
+    } else {
+        for (q = int_end + 1; q < frac_end && *q == '0'; q++) {}
+        magnitude = -(q - int_end - 1) + exp;
+    }
+    return magnitude > 0 ? numeric_limits<double>::infinity() : 0.0;
+}
+
+
+Token::Ptr make_number(string_view text) {
+    const char *p = text.data();
+    const char *const end = p + text.size();
+
+    const char *int_end = skip_digits(p, end);
+    bool has_dot = int_end < end && *int_end == '.';
+    const char *frac_end = has_dot ? skip_digits(int_end + 1, end) : int_end;
+
+    int64_t exp = 0;
+    int exp_sign = 1;
+    if (frac_end < end) {
+        const char *q = frac_end + 1;   // e or E
+        if (*q == '+' || *q == '-') {
+            exp_sign = *q++ == '-' ? -1 : 1;
+        }
+        exp = parse_exp(q, end) * exp_sign;
+    }
+
+    int64_t iv;
+    if (!has_dot && exp_sign > 0 && parse_int(p, int_end, exp, iv)) {
+        return make_shared<TokenInt>(iv);
+    }
+    if (int_end == end) {
+        return make_shared<TokenBig>(BigInt::from_digits(text));
+    }
+
+    double dv = 0;
+    from_chars_result res = from_chars(p, end, dv, chars_format::general);
+    if (res.ec == errc::result_out_of_range) {
+        dv = out_of_range_value(p, int_end, frac_end, exp);
+    }
+    return make_shared<TokenFloat>(dv);
+}
@@ -0,0 +1,22 @@
+#ifndef CALCXX_NUMBER_H
+#define CALCXX_NUMBER_H
+
+
+#include <string_view>
+
+#include "tokens.h"
+
+
+using std::string_view;
+
+
+/*
+ * Convert a number literal accepted by the tokenizer: digits [. digits] [e [+-] digits].
+ * Literals without a dot or a negative exponent that fit in int64 become TokenInt,
+ * plain digits that do not fit become TokenBig, others become TokenFloat,
+ * correctly rounded like strtod().
+ */
+Token::Ptr make_number(string_view text);
+
+
+#endif //CALCXX_NUMBER_H
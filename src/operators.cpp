@@ -1,100 +1,417 @@
-#include <cassert>
+#include <cstdint>
 #include <limits>
-#include <memory>
-#include <numeric>
+#include <utility>
 
+#include "bigint.h"
 #include "operators.h"
 
 
-using std::accumulate;
-using std::dynamic_pointer_cast;
-using std::make_shared;
+using std::move;
 using std::numeric_limits;
 
 
-map<TokenType, OperatorFunc> g_builtin_operator_table = {
-    {TokenType::PLUS, op_add},
-    {TokenType::MINUS, op_sub},
-    {TokenType::MULT, op_mult},
-    {TokenType::DIV, op_div}
+const OpInfo g_op_info[OPCODE_COUNT] = {
+    // name   token              arity  prec  assoc        pure
+    {"POS",   TokenType::PLUS,   1,     1,    Assoc::RIGHT, true},
+    {"NEG",   TokenType::MINUS,  1,     1,    Assoc::RIGHT, true},
+    {"ADD",   TokenType::PLUS,   2,     1,    Assoc::LEFT,  true},
+    {"SUB",   TokenType::MINUS,  2,     1,    Assoc::LEFT,  true},
+    {"MULT",  TokenType::MULT,   2,     2,    Assoc::LEFT,  true},
+    {"DIV",   TokenType::DIV,    2,     2,    Assoc::LEFT,  true},
 };
 
 
-static double token_to_num(const Token::Ptr &tok) {
-    auto ti = dynamic_pointer_cast<TokenInt>(tok);
-    if (ti) {
-        return ti->value;
-    } else {
-        auto tf = dynamic_pointer_cast<TokenFloat>(tok);
-        assert(tf);
-        return tf->value;
+OpCode token_opcode(TokenType tt, size_t arity) {
+    if (arity == 1) {
+        switch (tt) {
+        case TokenType::PLUS:
+            return OpCode::POS;
+        case TokenType::MINUS:
+            return OpCode::NEG;
+        default:
+            break;
+        }
+    } else if (arity == 2) {
+        switch (tt) {
+        case TokenType::PLUS:
+            return OpCode::ADD;
+        case TokenType::MINUS:
+            return OpCode::SUB;
+        case TokenType::MULT:
+            return OpCode::MULT;
+        case TokenType::DIV:
+            return OpCode::DIV;
+        default:
+            break;
+        }
     }
+    return OpCode::COUNT;
 }
 
 
-static bool is_tokens_all_int(const vector<Token::Ptr> &args) {
-    for (auto tok : args) {
-        if (!dynamic_pointer_cast<TokenInt>(tok)) {
-            return false;
-        }
+/*
+ * Int arguments use exact int64 arithmetic, a result that overflows int64 is
+ * computed with BigInt and kept BIG. An int and a float are computed in double.
+ */
+
+struct Add {
+    static double apply(double a, double b) {
+        return a + b;
+    }
+
+    static BigInt apply(const BigInt &a, const BigInt &b) {
+        return a + b;
+    }
+
+    // returns true on overflow
+    static bool apply(int64_t a, int64_t b, int64_t *out) {
+        return __builtin_add_overflow(a, b, out);
+    }
+
+    // a + b wrapped around, the sign bit of the returned mask is set on overflow,
+    // unlike __builtin_add_overflow() this vectorizes
+    static int64_t apply_wrapped(int64_t a, int64_t b, int64_t *out) {
+        int64_t r = static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+        *out = r;
+        return (a ^ r) & (b ^ r);
+    }
+};
+
+struct Sub {
+    static double apply(double a, double b) {
+        return a - b;
     }
-    return true;
+
+    static BigInt apply(const BigInt &a, const BigInt &b) {
+        return a - b;
+    }
+
+    static bool apply(int64_t a, int64_t b, int64_t *out) {
+        return __builtin_sub_overflow(a, b, out);
+    }
+
+    static int64_t apply_wrapped(int64_t a, int64_t b, int64_t *out) {
+        int64_t r = static_cast<int64_t>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b));
+        *out = r;
+        return (a ^ b) & (a ^ r);
+    }
+};
+
+struct Mult {
+    static double apply(double a, double b) {
+        return a * b;
+    }
+
+    static BigInt apply(const BigInt &a, const BigInt &b) {
+        return a * b;
+    }
+
+    static bool apply(int64_t a, int64_t b, int64_t *out) {
+        return __builtin_mul_overflow(a, b, out);
+    }
+
+    // int64 multiplication does not vectorize before AVX-512 anyway
+    static int64_t apply_wrapped(int64_t a, int64_t b, int64_t *out) {
+        return -static_cast<int64_t>(__builtin_mul_overflow(a, b, out));
+    }
+};
+
+
+template<class Op>
+static Value kernel_ii(const Value &a, const Value &b) {
+    int64_t result;
+    if (Op::apply(a.ival, b.ival, &result)) {
+        return Value::of_big(Op::apply(BigInt(a.ival), BigInt(b.ival)));
+    }
+    return Value::of_int(result);
 }
 
+template<class Op>
+static Value kernel_if(const Value &a, const Value &b) {
+    return Value::of_float(Op::apply(static_cast<double>(a.ival), b.fval));
+}
 
-static Token::Ptr best_num_token(double num, const vector<Token::Ptr> &args) {
-    if (is_tokens_all_int(args)) {
-        return make_shared<TokenInt>(num);
-    } else {
-        return make_shared<TokenFloat>(num);
+template<class Op>
+static Value kernel_fi(const Value &a, const Value &b) {
+    return Value::of_float(Op::apply(a.fval, static_cast<double>(b.ival)));
+}
+
+template<class Op>
+static Value kernel_ff(const Value &a, const Value &b) {
+    return Value::of_float(Op::apply(a.fval, b.fval));
+}
+
+
+// a is BIG or tmp set to the int a
+static const BigInt &as_big(const Value &a, BigInt &tmp) {
+    if (a.type == ValueType::BIG) {
+        return a.big_value();
     }
+    tmp = BigInt(a.ival);
+    return tmp;
 }
 
+// ints with at least one BIG
+template<class Op>
+static Value kernel_big(const Value &a, const Value &b) {
+    BigInt ta, tb;
+    return Value::of_big(Op::apply(as_big(a, ta), as_big(b, tb)));
+}
 
-Token::Ptr op_add(const vector<Token::Ptr> &args) {
-    assert(args.size() > 0);
-    double sum = accumulate(
-        args.begin(), args.end(), 0.0,
-        [](double result, Token::Ptr tok) {
-            return result + token_to_num(tok);
-        });
-    return best_num_token(sum, args);
+// a BIG and a float
+template<class Op>
+static Value kernel_big_float(const Value &a, const Value &b) {
+    return Value::of_float(Op::apply(a.to_double(), b.to_double()));
 }
 
-Token::Ptr op_sub(const vector<Token::Ptr> &args) {
-    double v1 = 0, v2 = 0;
-    if (args.size() == 1) {
-        v1 = 0;
-        v2 = token_to_num(args[0]);
-    } else if (args.size() == 2) {
-        v1 = token_to_num(args[0]);
-        v2 = token_to_num(args[1]);
+
+static Value div_ii(const Value &a, const Value &b) {
+    if (b.ival == 0) {
+        return Value::of_float(numeric_limits<double>::infinity());
+    }
+    if (b.ival == -1) {
+        return kernel_ii<Sub>(Value::of_int(0), a);
+    }
+    if (a.ival % b.ival == 0) {
+        return Value::of_int(a.ival / b.ival);
     } else {
-        assert(!"Unreachable");
+        return Value::of_float(static_cast<double>(a.ival) / static_cast<double>(b.ival));
     }
-    return best_num_token(v1 - v2, args);
 }
 
-Token::Ptr op_mult(const vector<Token::Ptr> &args) {
-    assert(args.size() == 2);
-    double v1 = token_to_num(args[0]);
-    double v2 = token_to_num(args[1]);
-    return best_num_token(v1 * v2, args);
+// ints with at least one BIG, the exact quotient or a float like div_ii()
+static Value div_big(const Value &a, const Value &b) {
+    if (b.is_int() && b.ival == 0) {
+        return Value::of_float(numeric_limits<double>::infinity());
+    }
+    BigInt ta, tb;
+    const BigInt &x = as_big(a, ta);
+    const BigInt &y = as_big(b, tb);
+    BigInt quot, rem;
+    BigInt::divmod(x, y, quot, rem);
+    if (rem.is_zero()) {
+        return Value::of_big(move(quot));
+    }
+    return Value::of_float(BigInt::div_to_double(x, y));
 }
 
-Token::Ptr op_div(const vector<Token::Ptr> &args) {
-    assert(args.size() == 2);
-    double v1 = token_to_num(args[0]);
-    double v2 = token_to_num(args[1]);
+static Value div_float(double v1, double v2) {
     if (v2 == 0.0) {
-        double result = std::numeric_limits<double>::infinity();
-        return make_shared<TokenFloat>(result);
-    } else {
-        double result = v1 / v2;
-        if (is_tokens_all_int(args) && (int64_t)v1 % (int64_t)v2 == 0) {
-            return make_shared<TokenInt>(result);
-        } else {
-            return make_shared<TokenFloat>(result);
+        return Value::of_float(numeric_limits<double>::infinity());
+    }
+    return Value::of_float(v1 / v2);
+}
+
+static Value div_if(const Value &a, const Value &b) {
+    return div_float(a.ival, b.fval);
+}
+
+static Value div_fi(const Value &a, const Value &b) {
+    return div_float(a.fval, b.ival);
+}
+
+static Value div_ff(const Value &a, const Value &b) {
+    return div_float(a.fval, b.fval);
+}
+
+static Value div_big_float(const Value &a, const Value &b) {
+    return div_float(a.to_double(), b.to_double());
+}
+
+
+// unary operators behave like their binary form with a zero on the left
+template<class Op>
+static Value kernel_i(const Value &a) {
+    return kernel_ii<Op>(Value::of_int(0), a);
+}
+
+template<class Op>
+static Value kernel_f(const Value &a) {
+    return Value::of_float(Op::apply(0.0, a.fval));
+}
+
+template<class Op>
+static Value kernel_b(const Value &a) {
+    return Value::of_big(Op::apply(BigInt(), a.big_value()));
+}
+
+
+#define BINARY_KERNELS(Op) { \
+    kernel_ii<Op>, kernel_if<Op>, kernel_big<Op>, \
+    kernel_fi<Op>, kernel_ff<Op>, kernel_big_float<Op>, \
+    kernel_big<Op>, kernel_big_float<Op>, kernel_big<Op>}
+
+const UnaryKernel g_unary_kernels[OPCODE_COUNT][3] = {
+    {kernel_i<Add>, kernel_f<Add>, kernel_b<Add>},  // POS
+    {kernel_i<Sub>, kernel_f<Sub>, kernel_b<Sub>},  // NEG
+    {},
+    {},
+    {},
+    {},
+};
+
+const BinaryKernel g_binary_kernels[OPCODE_COUNT][9] = {
+    {},
+    {},
+    BINARY_KERNELS(Add),
+    BINARY_KERNELS(Sub),
+    BINARY_KERNELS(Mult),
+    {
+        div_ii, div_if, div_big,
+        div_fi, div_ff, div_big_float,
+        div_big, div_big_float, div_big
+    },
+};
+
+#undef BINARY_KERNELS
+
+
+/*
+ * Batch kernels. The loops have a fixed trip count and restrict operands so
+ * they vectorize, and are cloned for a few instruction sets with the best
+ * one picked at load time. Converting int64 to double only vectorizes with
+ * AVX-512DQ, the other clones run those loops scalar.
+ */
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define BATCH_TARGETS __attribute__((target_clones("arch=x86-64-v4", "avx2", "default")))
+#else
+#define BATCH_TARGETS
+#endif
+
+
+template<class Op, class A, class B>
+BATCH_TARGETS
+static void batch_loop(const A *__restrict a, const B *__restrict b, double *__restrict out) {
+    for (size_t i = 0; i < BATCH_SIZE; i++) {
+        out[i] = Op::apply(static_cast<double>(a[i]), static_cast<double>(b[i]));
+    }
+}
+
+template<class Op, class A, class B>
+static BatchType batch_kernel(const void *a, const void *b, void *out, size_t) {
+    batch_loop<Op, A, B>(
+        static_cast<const A *>(a), static_cast<const B *>(b), static_cast<double *>(out));
+    return BatchType::FLOAT;
+}
+
+
+// returns true if any row overflowed, padding rows included
+template<class Op>
+BATCH_TARGETS
+static bool batch_int_loop(
+    const int64_t *__restrict a, const int64_t *__restrict b, int64_t *__restrict out)
+{
+    int64_t overflow = 0;
+    for (size_t i = 0; i < BATCH_SIZE; i++) {
+        overflow |= Op::apply_wrapped(a[i], b[i], &out[i]);
+    }
+    return overflow < 0;
+}
+
+// like kernel_ii() for each row, rows that overflow are BIG so the block is MIXED
+template<class Op>
+static BatchType batch_int_kernel(const void *a, const void *b, void *out, size_t n) {
+    const int64_t *ia = static_cast<const int64_t *>(a);
+    const int64_t *ib = static_cast<const int64_t *>(b);
+    if (!batch_int_loop<Op>(ia, ib, static_cast<int64_t *>(out))) {
+        return BatchType::INT;
+    }
+    for (size_t i = 0; i < n; i++) {
+        int64_t result;
+        if (Op::apply(ia[i], ib[i], &result)) {
+            return BatchType::MIXED;
         }
     }
+    return BatchType::INT;
+}
+
+
+// like div_float() for each row
+template<class A, class B>
+BATCH_TARGETS
+static void batch_div_float(const A *__restrict a, const B *__restrict b, double *__restrict out) {
+    for (size_t i = 0; i < BATCH_SIZE; i++) {
+        double v2 = static_cast<double>(b[i]);
+        double q = static_cast<double>(a[i]) / v2;
+        out[i] = v2 == 0.0 ? numeric_limits<double>::infinity() : q;
+    }
+}
+
+template<class A, class B>
+static BatchType batch_div(const void *a, const void *b, void *out, size_t) {
+    batch_div_float<A, B>(
+        static_cast<const A *>(a), static_cast<const B *>(b), static_cast<double *>(out));
+    return BatchType::FLOAT;
 }
+
+// like div_ii(), the result is int only if every row divides exactly,
+// INT64_MIN / -1 is BIG so a block with it is MIXED
+static BatchType batch_div_ii(const void *a, const void *b, void *out, size_t n) {
+    const int64_t *ia = static_cast<const int64_t *>(a);
+    const int64_t *ib = static_cast<const int64_t *>(b);
+    int64_t *iout = static_cast<int64_t *>(out);
+    size_t exact = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (ib[i] == -1 && ia[i] == numeric_limits<int64_t>::min()) {
+            return BatchType::MIXED;
+        }
+        bool is_exact = ib[i] != 0 && ia[i] % ib[i] == 0;
+        iout[i] = is_exact ? ia[i] / ib[i] : 0;
+        exact += is_exact;
+    }
+
+    if (exact == n) {
+        // keep the padding rows zero for the kernels after this one
+        for (size_t i = n; i < BATCH_SIZE; i++) {
+            iout[i] = 0;
+        }
+        return BatchType::INT;
+    } else if (exact == 0) {
+        batch_div_float(ia, ib, static_cast<double *>(out));
+        return BatchType::FLOAT;
+    }
+    return BatchType::MIXED;
+}
+
+
+// unary operators are their binary form with a zero on the left, like the scalar kernels
+template<class A, BatchBinaryKernel kernel>
+static BatchType batch_unary(const void *a, void *out, size_t n) {
+    static const A zeros[BATCH_SIZE] = {};
+    return kernel(zeros, a, out, n);
+}
+
+
+#define BATCH_KERNELS(Op) { \
+    batch_int_kernel<Op>, batch_kernel<Op, int64_t, double>, \
+    batch_kernel<Op, double, int64_t>, batch_kernel<Op, double, double>}
+
+const BatchUnaryKernel g_batch_unary_kernels[OPCODE_COUNT][2] = {
+    {   // POS
+        batch_unary<int64_t, batch_int_kernel<Add>>,
+        batch_unary<double, batch_kernel<Add, double, double>>
+    },
+    {   // NEG
+        batch_unary<int64_t, batch_int_kernel<Sub>>,
+        batch_unary<double, batch_kernel<Sub, double, double>>
+    },
+    {},
+    {},
+    {},
+    {},
+};
+
+const BatchBinaryKernel g_batch_binary_kernels[OPCODE_COUNT][4] = {
+    {},
+    {},
+    BATCH_KERNELS(Add),
+    BATCH_KERNELS(Sub),
+    BATCH_KERNELS(Mult),
+    {
+        batch_div_ii, batch_div<int64_t, double>,
+        batch_div<double, int64_t>, batch_div<double, double>
+    },
+};
+
+#undef BATCH_KERNELS
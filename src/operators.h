@@ -2,26 +2,126 @@
 #define CALCXX_OPERATORS_H
 
 
-#include <functional>
-#include <map>
-#include <vector>
+#include <cstddef>
+#include <cstdint>
 
 #include "tokens.h"
+#include "value.h"
 
 
-using std::function;
-using std::map;
-using std::vector;
+enum class OpCode : uint8_t {
+    POS,
+    NEG,
+    ADD,
+    SUB,
+    MULT,
+    DIV,
 
+    COUNT,
+};
 
-typedef function<Token::Ptr (const vector<Token::Ptr> &)> OperatorFunc;
-extern map<TokenType, OperatorFunc> g_builtin_operator_table;
 
+static const size_t OPCODE_COUNT = static_cast<size_t>(OpCode::COUNT);
 
-Token::Ptr op_add(const vector<Token::Ptr> &args);
-Token::Ptr op_sub(const vector<Token::Ptr> &args);
-Token::Ptr op_mult(const vector<Token::Ptr> &args);
-Token::Ptr op_div(const vector<Token::Ptr> &args);
+
+enum class Assoc : uint8_t {
+    LEFT,
+    RIGHT,
+};
+
+
+struct OpInfo {
+    const char *name;
+    TokenType token;
+    uint8_t arity;
+    int8_t precedence;
+    Assoc assoc;
+    bool pure;
+};
+
+
+extern const OpInfo g_op_info[OPCODE_COUNT];
+
+
+inline const OpInfo &op_info(OpCode op) {
+    return g_op_info[static_cast<size_t>(op)];
+}
+
+
+REPR(OpCode) {
+    return value < OpCode::COUNT ? op_info(value).name : "COUNT";
+}
+
+
+// OpCode::COUNT if tt is not an operator taking arity arguments
+OpCode token_opcode(TokenType tt, size_t arity);
+
+
+typedef Value (*UnaryKernel)(const Value &a);
+typedef Value (*BinaryKernel)(const Value &a, const Value &b);
+
+// indexed by opcode, then by the combination of argument types from kernel_index()
+extern const UnaryKernel g_unary_kernels[OPCODE_COUNT][3];
+extern const BinaryKernel g_binary_kernels[OPCODE_COUNT][9];
+
+
+// 0 for INT, 1 for FLOAT, 2 for BIG, from bits 2 and 3 of the type chars
+inline size_t kernel_index(const Value &a) {
+    return 2 - ((static_cast<size_t>(a.type) >> 2) & 3);
+}
+
+static_assert(
+    (static_cast<size_t>(ValueType::INT) >> 2 & 3) == 2
+        && (static_cast<size_t>(ValueType::FLOAT) >> 2 & 3) == 1
+        && (static_cast<size_t>(ValueType::BIG) >> 2 & 3) == 0,
+    "kernel_index() depends on the ValueType chars");
+
+inline size_t kernel_index(const Value &a, const Value &b) {
+    return kernel_index(a) * 3 + kernel_index(b);
+}
+
+inline Value apply_unary(OpCode op, const Value &a) {
+    return g_unary_kernels[static_cast<size_t>(op)][kernel_index(a)](a);
+}
+
+inline Value apply_binary(OpCode op, const Value &a, const Value &b) {
+    return g_binary_kernels[static_cast<size_t>(op)][kernel_index(a, b)](a, b);
+}
+
+
+static const size_t BATCH_SIZE = 256;
+
+
+// type of the values written by a batch kernel, MIXED if the rows disagree
+enum class BatchType : uint8_t {
+    INT,    // int64_t
+    FLOAT,  // double
+    MIXED,
+};
+
+
+/*
+ * Batch kernels apply an operator to BATCH_SIZE rows of int64_t or double arrays,
+ * with the same results as the scalar kernels row by row. Arrays must not overlap.
+ * Only the first n rows decide the returned type, the others are padding.
+ * Only int kernels return MIXED, when some rows are exact and some are not or
+ * some rows overflow to BIG. out is then unspecified and the rows must be
+ * evaluated one by one.
+ */
+typedef BatchType (*BatchUnaryKernel)(const void *a, void *out, size_t n);
+typedef BatchType (*BatchBinaryKernel)(const void *a, const void *b, void *out, size_t n);
+
+extern const BatchUnaryKernel g_batch_unary_kernels[OPCODE_COUNT][2];
+extern const BatchBinaryKernel g_batch_binary_kernels[OPCODE_COUNT][4];
+
+
+inline size_t kernel_index(BatchType a) {
+    return a == BatchType::FLOAT;
+}
+
+inline size_t kernel_index(BatchType a, BatchType b) {
+    return (kernel_index(a) << 1) | kernel_index(b);
+}
 
 
 #endif //CALCXX_OPERATORS_H
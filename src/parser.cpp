@@ -1,87 +1,69 @@
 #include <cassert>
-#include <memory>
 #include <string>
 
 #include "parser.h"
+#include "value.h"
 
 
-using std::make_shared;
 using std::string;
 
 
 void Parser::feed(const Token::Ptr &tok) {
-    if (this->states.empty()) {
-        if (tok->type == TokenType::END) {
-            assert(this->nodes.size() == 1);
-        } else {
-            this->mismatch({TokenType::END}, tok);
-        }
-    } else if (this->states.back() == ParserState::exp) {
-        if (tok->type == TokenType::PLUS || tok->type == TokenType::MINUS) {
-            Node::Ptr node = make_shared<Node>(tok);
-            this->nodes.push_back(node);
-            this->states.back() = ParserState::exp_signed;
-            this->enter_xexp();
-        } else {
-            this->states.back() = ParserState::exp_cont;
-            this->enter_xexp();
-            this->feed(tok);
-        }
-    } else if (this->states.back() == ParserState::exp_signed) {
-        this->grow_body();
-        this->states.back() = ParserState::exp_cont;
-        this->feed(tok);
-    } else if(this->states.back() == ParserState::exp_cont) {
-        if (tok->type == TokenType::PLUS || tok->type == TokenType::MINUS) {
-            Node::Ptr node = make_shared<Node>(tok);
-            this->grow_head(node);
-            this->states.back() = ParserState::exp_end;
-            this->enter_xexp();
-        } else {
-            this->states.pop_back();
-            this->feed(tok);
+    TokenType tt = tok->type;
+    OpCode op;
+
+    switch (this->state) {
+    case ParserState::exp_start:
+        op = token_opcode(tt, 1);
+        if (op != OpCode::COUNT) {
+            this->ops.push_back({tt, op, op_info(op).precedence});
+            this->state = ParserState::operand;
+            return;
         }
-    } else if (this->states.back() == ParserState::exp_end) {
-        this->grow_body();
-        this->states.back() = ParserState::exp_cont;
-        this->feed(tok);
-    } else if (this->states.back() == ParserState::xexp) {
-        this->states.back() = ParserState::xexp_cont;
-        this->feed(tok);
-    } else if (this->states.back() == ParserState::xexp_cont) {
-        if (tok->type == TokenType::MULT || tok->type == TokenType::DIV) {
-            Node::Ptr node = make_shared<Node>(tok);
-            this->grow_head(node);
-            this->states.back() = ParserState::xexp_end;
-            this->enter_lexp();
+        // fall through
+    case ParserState::operand:
+        if (tt == TokenType::LPAR) {
+            this->ops.push_back({tt, OpCode::COUNT, -1});
+            this->depth++;
+            this->state = ParserState::exp_start;
+        } else if (tt == TokenType::INT || tt == TokenType::FLOAT || tt == TokenType::BIG) {
+            this->nodes.push_back(this->ast.add_value(token_to_value(*tok)));
+            this->state = ParserState::infix;
+        } else if (tt == TokenType::NAME) {
+            const string &name = static_cast<const TokenName &>(*tok).name;
+            this->nodes.push_back(this->ast.add_variable(name));
+            this->state = ParserState::infix;
         } else {
-            this->states.pop_back();
-            this->feed(tok);
+            this->mismatch(
+                {TokenType::LPAR, TokenType::INT, TokenType::FLOAT, TokenType::NAME}, tok);
         }
-    } else if (this->states.back() == ParserState::xexp_end) {
-        this->grow_body();
-        this->states.back() = ParserState::xexp_cont;
-        this->feed(tok);
-    } else if (this->states.back() == ParserState::lexp) {
-        if (tok->type == TokenType::LPAR) {
-            this->states.back() = ParserState::lexp_rpar;
-            this->enter_exp();
-        } else if (tok->type == TokenType::INT || tok->type == TokenType::FLOAT) {
-            Node::Ptr node = make_shared<Node>(tok);
-            this->nodes.push_back(node);
-            this->states.pop_back();
+        return;
+    case ParserState::infix:
+        op = token_opcode(tt, 2);
+        if (op != OpCode::COUNT) {
+            const OpInfo &info = op_info(op);
+            // operators of equal precedence are reduced first only if left associative
+            this->reduce(info.assoc == Assoc::LEFT ? info.precedence : info.precedence + 1);
+            this->ops.push_back({tt, op, info.precedence});
+            this->state = ParserState::operand;
+        } else if (tt == TokenType::RPAR && this->depth > 0) {
+            this->reduce(0);
+            this->ops.pop_back();
+            this->depth--;
+        } else if (tt == TokenType::END && this->depth == 0) {
+            this->reduce(0);
+            this->state = ParserState::end;
         } else {
-            this->mismatch({TokenType::LPAR, TokenType::INT, TokenType::FLOAT}, tok);
+            this->mismatch({this->depth > 0 ? TokenType::RPAR : TokenType::END}, tok);
         }
-    } else if (this->states.back() == ParserState::lexp_rpar) {
-        if (tok->type == TokenType::RPAR) {
-            this->states.pop_back();
-        } else {
-            this->mismatch({TokenType::RPAR}, tok);
+        return;
+    case ParserState::end:
+        if (tt != TokenType::END) {
+            this->mismatch({TokenType::END}, tok);
         }
-    } else {
-        assert(!"Unreachable");
+        return;
     }
+    assert(!"Unreachable");
 }
 
 void Parser::mismatch(vector<TokenType> expects, const Token::Ptr &got) {
@@ -95,34 +77,34 @@ void Parser::mismatch(vector<TokenType> expects, const Token::Ptr &got) {
     throw ParserError(msg);
 }
 
-void Parser::enter_exp() {
-    this->states.push_back(ParserState::exp);
-}
-
-void Parser::enter_xexp() {
-    this->states.push_back(ParserState::xexp);
-    this->enter_lexp();
-}
-
-void Parser::enter_lexp() {
-    this->states.push_back(ParserState::lexp);
-}
+// apply the pending operators down to min_precedence, stops at '('
+void Parser::reduce(int8_t min_precedence) {
+    while (!this->ops.empty() && this->ops.back().precedence >= min_precedence) {
+        const PendingOp &pending = this->ops.back();
+        size_t arity = op_info(pending.op).arity;
+        assert(this->nodes.size() >= arity);
 
-Node::Ptr Parser::get_result() {
-    assert(this->states.empty() && this->nodes.size() == 1);
-    Node::Ptr node = this->nodes.back();
-    this->nodes.pop_back();
-    return node;
+        NodeId node = this->ast.add_operator(pending.type);
+        for (size_t i = this->nodes.size() - arity; i < this->nodes.size(); i++) {
+            this->ast.add_child(node, this->nodes[i]);
+        }
+        this->nodes.resize(this->nodes.size() - arity);
+        this->nodes.push_back(node);
+        this->ops.pop_back();
+    }
 }
 
-void Parser::grow_body() {
-    Node::Ptr child = this->nodes.back();
+const Ast &Parser::get_result() {
+    assert(this->state == ParserState::end && this->nodes.size() == 1);
+    this->ast.root = this->nodes.back();
     this->nodes.pop_back();
-    this->nodes.back()->children.push_back(child);
+    return this->ast;
 }
 
-void Parser::grow_head(Node::Ptr head) {
-    Node::Ptr child = this->nodes.back();
-    head->children.push_back(child);
-    this->nodes.back() = head;
+void Parser::reset() {
+    this->state = ParserState::exp_start;
+    this->depth = 0;
+    this->ast.clear();
+    this->nodes.clear();
+    this->ops.clear();
 }
@@ -4,8 +4,9 @@
 
 #include <vector>
 
+#include "ast.h"
 #include "exception.h"
-#include "node.h"
+#include "operators.h"
 #include "tokens.h"
 
 
@@ -14,45 +15,49 @@ using std::vector;
 
 
 /*
- * exp  -> ± xexp exp_cont
- *       |   xexp exp_cont
- * exp_cont -> [± xexp]*
- * xexp -> lexp xexp_cont
- * xpex_cont -> [* lexp]*
- * lexp -> ( exp ) | number
+ * exp  -> [prefix] operand [infix operand]*
+ * operand -> ( exp ) | number | name
+ *
+ * Prefix operators are only allowed at the start of an exp, their operand
+ * extends over every infix operator with a higher precedence, so -1 * 2 is
+ * -(1 * 2) while -1 + 2 is (-1) + 2.
+ *
+ * Operators, their arity, precedence and associativity come from g_op_info,
+ * the parser itself only knows about numbers, parentheses and END.
  */
 
 enum class ParserState {
-    exp,
-    exp_cont,
-    exp_signed,
-    exp_end,
-    xexp,
-    xexp_cont,
-    xexp_end,
-    lexp,
-    lexp_rpar,
+    exp_start,  // expect a prefix operator or an operand
+    operand,    // expect an operand
+    infix,      // expect an infix operator, ')' or END
+    end,        // the expression is complete
+};
+
+
+struct PendingOp {
+    TokenType type;
+    OpCode op;          // COUNT for '('
+    int8_t precedence;  // -1 for '(', so that it stops every reduction
 };
 
 
 class Parser {
 public:
-    Parser() {
-        this->enter_exp();
-    }
     void feed(const Token::Ptr &tok);
-    Node::Ptr get_result();
+    // valid until the next reset()
+    const Ast &get_result();
+    // start a new expression, keeping the allocated memory
+    void reset();
 
 private:
-    vector<Node::Ptr> nodes;
-    vector<ParserState> states;
+    ParserState state = ParserState::exp_start;
+    size_t depth = 0;           // number of '(' in ops
+    Ast ast;
+    vector<NodeId> nodes;       // operands not yet attached to an operator
+    vector<PendingOp> ops;
 
     void mismatch(vector<TokenType> expects, const Token::Ptr &got);
-    void enter_exp();
-    void enter_xexp();
-    void enter_lexp();
-    void grow_body();
-    void grow_head(Node::Ptr head);
+    void reduce(int8_t min_precedence);
 };
 
 
@@ -0,0 +1,105 @@
+#include <cstring>
+
+#include "result_cache.h"
+
+
+using std::memcpy;
+
+
+ResultCache::ResultCache(size_t capacity) : max_entries(capacity) {}
+
+
+// the two kinds of keys start with different chars so they never collide
+void ResultCache::line_key(string_view line, string &key) {
+    key.assign(1, 'l');
+    key.append(line.data(), line.size());
+}
+
+
+// the type char of each token, then the bytes of int and float values or the
+// text of other values ended by a '\0' that they can not contain
+void ResultCache::token_key(const vector<Token::Ptr> &tokens, string &key) {
+    key.assign(1, 't');
+    for (const Token::Ptr &tok : tokens) {
+        key += static_cast<char>(tok->type);
+        switch (tok->type) {
+        case TokenType::INT: {
+            char bytes[sizeof(int64_t)];
+            memcpy(bytes, &static_cast<const TokenInt &>(*tok).value, sizeof(bytes));
+            key.append(bytes, sizeof(bytes));
+            break;
+        }
+        case TokenType::FLOAT: {
+            char bytes[sizeof(double)];
+            memcpy(bytes, &static_cast<const TokenFloat &>(*tok).value, sizeof(bytes));
+            key.append(bytes, sizeof(bytes));
+            break;
+        }
+        case TokenType::BIG:
+            key += static_cast<const TokenBig &>(*tok).value.to_string();
+            key += '\0';
+            break;
+        case TokenType::NAME:
+            key += static_cast<const TokenName &>(*tok).name;
+            key += '\0';
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+
+bool ResultCache::lookup(string_view key, Value &value, bool count_miss) {
+    auto it = this->index.find(key);
+    if (it == this->index.end()) {
+        this->miss_count += count_miss;
+        return false;
+    }
+    Entry &entry = this->entries[it->second];
+    entry.referenced = true;
+    value = entry.value;
+    this->hit_count++;
+    return true;
+}
+
+
+void ResultCache::insert(string_view key, const Value &value) {
+    if (this->max_entries == 0) {
+        return;
+    }
+    auto it = this->index.find(key);
+    if (it != this->index.end()) {
+        this->entries[it->second].value = value;
+        return;
+    }
+
+    size_t slot;
+    if (this->entries.size() < this->max_entries) {
+        slot = this->entries.size();
+        this->entries.emplace_back();
+    } else {
+        while (this->entries[this->hand].referenced) {
+            this->entries[this->hand].referenced = false;
+            this->hand = (this->hand + 1) % this->max_entries;
+        }
+        slot = this->hand;
+        this->hand = (this->hand + 1) % this->max_entries;
+        this->index.erase(this->entries[slot].key);
+    }
+
+    Entry &entry = this->entries[slot];
+    entry.key.assign(key.data(), key.size());
+    entry.value = value;
+    entry.referenced = false;
+    this->index.emplace(entry.key, slot);
+}
+
+
+void ResultCache::clear() {
+    this->entries.clear();
+    this->index.clear();
+    this->hand = 0;
+    this->hit_count = 0;
+    this->miss_count = 0;
+}
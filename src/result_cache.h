@@ -0,0 +1,85 @@
+#ifndef CALCXX_RESULT_CACHE_H
+#define CALCXX_RESULT_CACHE_H
+
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "tokens.h"
+#include "value.h"
+
+
+using std::deque;
+using std::string;
+using std::string_view;
+using std::unordered_map;
+using std::vector;
+
+
+/*
+ * A bounded map from lines to the values they evaluated to, so lines seen
+ * before skip tokenizing, parsing and evaluation.
+ *
+ * A line has two keys: line_key() of its exact text, which can be looked up
+ * before tokenizing, and token_key() of its token types and values, which
+ * lines differing only in whitespace share. When the cache is full the CLOCK
+ * algorithm picks the entry to replace: a hit sets the reference bit of an
+ * entry, and the hand clears bits until it finds an entry without one. New
+ * entries start without the bit, so lines seen once are replaced before the
+ * ones that were hit.
+ */
+class ResultCache {
+public:
+    // a cache with capacity 0 is disabled, lookup() always misses,
+    // memory is only taken as entries are added
+    explicit ResultCache(size_t capacity = 0);
+
+    // replace key with the key of the text of a line
+    static void line_key(string_view line, string &key);
+    // replace key with the canonical form of the tokens of a line, positions are ignored
+    static void token_key(const vector<Token::Ptr> &tokens, string &key);
+
+    // sets value and returns true if key is cached, counts a hit, or a miss
+    // unless count_miss is false because another key of the line follows
+    bool lookup(string_view key, Value &value, bool count_miss = true);
+    // adds key, replacing an entry if the cache is full
+    void insert(string_view key, const Value &value);
+    void clear();
+
+    size_t capacity() const {
+        return this->max_entries;
+    }
+
+    size_t size() const {
+        return this->entries.size();
+    }
+
+    size_t hits() const {
+        return this->hit_count;
+    }
+
+    size_t misses() const {
+        return this->miss_count;
+    }
+
+private:
+    struct Entry {
+        string key;
+        Value value;
+        bool referenced = false;
+    };
+
+    size_t max_entries;
+    deque<Entry> entries;   // appending never moves the keys that index points into
+    unordered_map<string_view, size_t> index;
+    size_t hand = 0;
+    size_t hit_count = 0;
+    size_t miss_count = 0;
+};
+
+
+#endif //CALCXX_RESULT_CACHE_H
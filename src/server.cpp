@@ -0,0 +1,371 @@
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "exception.h"
+#include "server.h"
+
+
+using std::memcpy;
+using std::strerror;
+using std::thread;
+using std::to_string;
+using std::unordered_map;
+
+
+const size_t Server::MAX_LINE;
+const size_t Server::MAX_PENDING;
+
+
+static IOError socket_error(const string &what) {
+    return IOError(what + ": " + strerror(errno));
+}
+
+
+static const int MAX_EVENTS = 64;
+static const size_t READ_SIZE = 1 << 16;
+
+
+struct Connection {
+    string in;              // the start of a line whose newline has not arrived
+    string out;             // responses not written yet, from out_pos on
+    size_t out_pos = 0;
+    bool eof = false;       // the client will not send more
+    uint32_t events = 0;    // registered with epoll
+
+    size_t pending() const {
+        return this->out.size() - this->out_pos;
+    }
+};
+
+
+struct Server::Loop {
+    int epfd = -1;
+    Calculator calc;
+    unordered_map<int, Connection> conns;
+
+    Loop(EvalMode mode, size_t cache_size) : calc(mode, cache_size) {}
+
+    ~Loop() {
+        for (auto &item : this->conns) {
+            close(item.first);
+        }
+        if (this->epfd >= 0) {
+            close(this->epfd);
+        }
+    }
+
+    void add(int fd, uint32_t events) {
+        epoll_event ev = {};
+        ev.events = events;
+        ev.data.fd = fd;
+        if (epoll_ctl(this->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            throw socket_error("epoll_ctl");
+        }
+    }
+
+    void close_connection(int fd) {
+        close(fd);      // also removes it from epfd
+        this->conns.erase(fd);
+    }
+};
+
+
+// the response line of one request line
+static void append_response(string &out, const LineResult &result) {
+    switch (result.status) {
+    case LineStatus::ok:
+        out += repr(result.value);
+        break;
+    case LineStatus::error:
+        out += "error: col " + to_string(result.start.rowno + 1) + ": ";
+        out += result.error;
+        break;
+    case LineStatus::blank:
+        break;
+    }
+    out += '\n';
+}
+
+
+// evaluates the complete lines of the bytes read, keeps the rest in conn.in
+static void serve_data(Calculator &calc, Connection &conn, string_view data) {
+    size_t newline = data.find('\n');
+    if (!conn.in.empty()) {
+        if (newline == string_view::npos) {
+            conn.in.append(data.data(), data.size());
+            return;
+        }
+        conn.in.append(data.data(), newline);
+        append_response(conn.out, calc.eval_line(conn.in));
+        conn.in.clear();
+        data.remove_prefix(newline + 1);
+        newline = data.find('\n');
+    }
+    while (newline != string_view::npos) {
+        append_response(conn.out, calc.eval_line(data.substr(0, newline)));
+        data.remove_prefix(newline + 1);
+        newline = data.find('\n');
+    }
+    conn.in.assign(data.data(), data.size());
+}
+
+
+// reads and answers what the client sent, writes what can be written,
+// returns false if the connection is done
+static bool serve_connection(
+    Calculator &calc, int epfd, int fd, Connection &conn, uint32_t revents, char *buf)
+{
+    if ((revents & (EPOLLIN | EPOLLHUP | EPOLLERR)) && (conn.events & EPOLLIN)) {
+        ssize_t n = read(fd, buf, READ_SIZE);
+        if (n > 0) {
+            serve_data(calc, conn, string_view(buf, size_t(n)));
+            if (conn.in.size() > Server::MAX_LINE) {
+                return false;
+            }
+        } else if (n == 0) {
+            conn.eof = true;
+            if (!conn.in.empty()) {
+                append_response(conn.out, calc.eval_line(conn.in));
+                conn.in.clear();
+            }
+        } else if (errno != EAGAIN && errno != EINTR) {
+            return false;
+        }
+    }
+
+    if (conn.pending() > 0) {
+        ssize_t n = send(fd, conn.out.data() + conn.out_pos, conn.pending(), MSG_NOSIGNAL);
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            return false;
+        }
+        conn.out_pos += n > 0 ? size_t(n) : 0;
+        if (conn.pending() == 0) {
+            conn.out.clear();
+            conn.out_pos = 0;
+        }
+    }
+    if (conn.eof && conn.pending() == 0) {
+        return false;
+    }
+
+    uint32_t events = (!conn.eof && conn.pending() < Server::MAX_PENDING ? uint32_t(EPOLLIN) : 0)
+        | (conn.pending() > 0 ? uint32_t(EPOLLOUT) : 0);
+    if (events != conn.events) {
+        epoll_event ev = {};
+        ev.events = events;
+        ev.data.fd = fd;
+        if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) != 0) {
+            return false;
+        }
+        conn.events = events;
+    }
+    return true;
+}
+
+
+static int listen_unix(const string &path) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw IOError(path + ": socket path too long");
+    }
+    memcpy(addr.sun_path, path.data(), path.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw socket_error(path);
+    }
+
+    // a socket file nobody accepts on was left by a server that did not exit cleanly
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool live = probe >= 0
+            && connect(probe, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (live) {
+            close(fd);
+            throw IOError(path + ": a server is already listening");
+        }
+        unlink(path.c_str());
+    }
+    if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0
+        || listen(fd, SOMAXCONN) != 0)
+    {
+        IOError exc = socket_error(path);
+        close(fd);
+        throw exc;
+    }
+    return fd;
+}
+
+
+// sets port to the bound port
+static int listen_tcp(int &port) {
+    string name = "127.0.0.1:" + to_string(port);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw socket_error(name);
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(uint16_t(port));
+    socklen_t len = sizeof(addr);
+    if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0
+        || listen(fd, SOMAXCONN) != 0
+        || getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) != 0)
+    {
+        IOError exc = socket_error(name);
+        close(fd);
+        throw exc;
+    }
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+
+Server::Server(const ServerOptions &options) : options(options) {
+    if (this->options.threads == 0) {
+        this->options.threads = 1;
+    }
+    try {
+        this->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (this->stop_fd < 0) {
+            throw socket_error("eventfd");
+        }
+        if (!options.unix_path.empty()) {
+            this->listen_fds.push_back(listen_unix(options.unix_path));
+        }
+        if (options.tcp_port >= 0) {
+            this->port = options.tcp_port;
+            this->listen_fds.push_back(listen_tcp(this->port));
+        }
+    } catch (const IOError &) {
+        this->close_all();
+        throw;
+    }
+}
+
+
+Server::~Server() {
+    this->close_all();
+}
+
+
+void Server::close_all() {
+    // the Unix socket is the first one bound
+    if (!this->listen_fds.empty() && !this->options.unix_path.empty()) {
+        unlink(this->options.unix_path.c_str());
+    }
+    for (int fd : this->listen_fds) {
+        close(fd);
+    }
+    this->listen_fds.clear();
+    if (this->stop_fd >= 0) {
+        close(this->stop_fd);
+        this->stop_fd = -1;
+    }
+}
+
+
+void Server::run() {
+    vector<unique_ptr<Loop>> loops;
+    for (size_t i = 0; i < this->options.threads; i++) {
+        loops.emplace_back(new Loop(this->options.mode, this->options.cache_size));
+        Loop &loop = *loops.back();
+        loop.epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (loop.epfd < 0) {
+            throw socket_error("epoll_create1");
+        }
+        // never read, so every loop keeps seeing it
+        loop.add(this->stop_fd, EPOLLIN);
+        for (int fd : this->listen_fds) {
+            loop.add(fd, EPOLLIN | EPOLLEXCLUSIVE);
+        }
+    }
+
+    vector<thread> workers;
+    for (size_t i = 1; i < loops.size(); i++) {
+        workers.emplace_back([this, &loops, i]() {
+            this->run_loop(*loops[i]);
+        });
+    }
+    this->run_loop(*loops[0]);
+    for (thread &worker : workers) {
+        worker.join();
+    }
+}
+
+
+void Server::stop() {
+    this->stopping.store(true);
+    uint64_t one = 1;
+    ssize_t written = write(this->stop_fd, &one, sizeof(one));
+    (void)written;
+}
+
+
+void Server::run_loop(Loop &loop) {
+    epoll_event events[MAX_EVENTS];
+    vector<char> buf(READ_SIZE);
+    while (!this->stopping.load()) {
+        int n = epoll_wait(loop.epfd, events, MAX_EVENTS, -1);
+        if (n < 0 && errno != EINTR) {
+            this->stop();
+            return;
+        }
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == this->stop_fd) {
+                continue;
+            }
+            bool listening = false;
+            for (int listen_fd : this->listen_fds) {
+                listening = listening || fd == listen_fd;
+            }
+            if (listening) {
+                // one connection per wakeup spreads them over the loops
+                int client = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (client < 0) {
+                    continue;
+                }
+                int one = 1;
+                setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                loop.conns[client].events = EPOLLIN;
+                try {
+                    loop.add(client, EPOLLIN);
+                } catch (const IOError &) {
+                    loop.close_connection(client);
+                }
+                continue;
+            }
+
+            auto it = loop.conns.find(fd);
+            if (it == loop.conns.end()) {
+                continue;   // closed while handling an earlier event
+            }
+            if (!serve_connection(loop.calc, loop.epfd, fd, it->second, events[i].events, buf.data())) {
+                loop.close_connection(fd);
+            }
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef CALCXX_SERVER_H
+#define CALCXX_SERVER_H
+
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "calculator.h"
+
+
+using std::atomic;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+
+struct ServerOptions {
+    string unix_path;           // empty for no Unix domain socket
+    int tcp_port = -1;          // -1 for no TCP socket, 0 for any free port
+    EvalMode mode = EvalMode::ast;
+    size_t cache_size = 0;      // of the ResultCache of each event loop
+    size_t threads = 1;         // event loops
+};
+
+
+/*
+ * Evaluates lines sent by clients over a Unix domain socket and/or a TCP port
+ * bound to 127.0.0.1.
+ *
+ * Each request line gets one response line, in order: the value, an empty
+ * line for a blank request, or "error: col N: <ExceptionType>: <message>".
+ * A last line without newline is evaluated when the client shuts down its
+ * side, after which the server closes the connection once the responses are
+ * written. Clients may send many lines without waiting for the responses.
+ *
+ * Every thread runs its own epoll event loop with its own Calculator, whose
+ * tokenizer, parser and evaluator buffers are reused by all the connections
+ * of that loop. The listening sockets are in every loop and a new connection
+ * wakes a single one, which then serves it until it is closed. Reading from a
+ * client pauses while MAX_PENDING bytes of its responses are not sent, and a
+ * line longer than MAX_LINE closes the connection.
+ */
+class Server {
+public:
+    static const size_t MAX_LINE = 1 << 20;
+    static const size_t MAX_PENDING = 1 << 20;
+
+    // creates and binds the sockets, throws IOError
+    explicit Server(const ServerOptions &options);
+    // closes the sockets and removes the Unix socket file
+    ~Server();
+
+    Server(const Server &) = delete;
+    Server &operator=(const Server &) = delete;
+
+    // serves until stop(), with options.threads event loops including the calling thread
+    void run();
+    // makes run() return, can be called from any thread or a signal handler
+    void stop();
+
+    // the bound port, useful with port 0, -1 without TCP
+    int tcp_port() const {
+        return this->port;
+    }
+
+private:
+    struct Loop;
+
+    ServerOptions options;
+    vector<int> listen_fds;
+    int stop_fd = -1;       // an eventfd, readable once stop() is called
+    int port = -1;
+    atomic<bool> stopping{false};
+
+    void run_loop(Loop &loop);
+    void close_all();
+};
+
+
+#endif //CALCXX_SERVER_H
@@ -0,0 +1,227 @@
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include "eval_ast.h"
+#include "simplify.h"
+#include "stats.h"
+
+
+using std::signbit;
+using std::vector;
+
+
+// what is known about the type of a subtree before evaluation
+enum class StaticType : uint8_t {
+    INT,    // INT or BIG
+    FLOAT,
+    ANY,
+};
+
+
+/*
+ * A simplified subtree: a constant, or a node already written to dst.
+ * Constants are only written to dst when they become an operand of a node
+ * that stays, so folded subtrees leave nothing behind.
+ */
+struct Simplified {
+    NodeId id;      // NO_NODE for a constant
+    Value value;
+    StaticType type;
+
+    static Simplified of_const(Value value) {
+        StaticType type = value.type == ValueType::FLOAT ? StaticType::FLOAT : StaticType::INT;
+        return {NO_NODE, value, type};
+    }
+
+    bool is_const() const {
+        return this->id == NO_NODE;
+    }
+
+    bool is_int_const(int64_t v) const {
+        return this->is_const() && this->value.is_int() && this->value.ival == v;
+    }
+
+    // matches int and float constants, 0.0 does not match -0.0
+    bool is_const(double v) const {
+        double d = this->value.to_double();
+        return this->is_const() && d == v && signbit(d) == signbit(v);
+    }
+};
+
+
+static StaticType result_type(OpCode op, StaticType t1, StaticType t2) {
+    if (t1 == StaticType::FLOAT || t2 == StaticType::FLOAT) {
+        return StaticType::FLOAT;
+    }
+    if (t1 == StaticType::ANY || t2 == StaticType::ANY || op == OpCode::DIV) {
+        return StaticType::ANY;     // int / int is a float if inexact
+    }
+    return StaticType::INT;
+}
+
+
+/*
+ * Returns the operand that op(lhs, rhs) always evaluates to, or nullptr.
+ * Int arithmetic is exact, so x - 0, x * 1 and x / 1 give back x for any x
+ * and an int constant. A float constant would turn an int x into a float.
+ * x + 0 is only kept out for INT x, for floats it turns -0.0 into 0.0. Ints
+ * that overflow become BIG, which is exact as well.
+ */
+static const Simplified *find_identity(OpCode op, const Simplified &lhs, const Simplified &rhs) {
+    auto is_zero = [](const Simplified &x, const Simplified &c) {
+        return c.is_int_const(0) || (x.type == StaticType::FLOAT && c.is_const(0.0));
+    };
+    auto is_one = [](const Simplified &x, const Simplified &c) {
+        return c.is_int_const(1) || (x.type == StaticType::FLOAT && c.is_const(1.0));
+    };
+
+    switch (op) {
+    case OpCode::ADD:
+        if (lhs.type == StaticType::INT && rhs.is_int_const(0)) {
+            return &lhs;
+        }
+        if (rhs.type == StaticType::INT && lhs.is_int_const(0)) {
+            return &rhs;
+        }
+        break;
+    case OpCode::SUB:
+        if (is_zero(lhs, rhs)) {
+            return &lhs;
+        }
+        break;
+    case OpCode::MULT:
+        if (is_one(lhs, rhs)) {
+            return &lhs;
+        }
+        if (is_one(rhs, lhs)) {
+            return &rhs;
+        }
+        break;
+    case OpCode::DIV:
+        if (is_one(lhs, rhs)) {
+            return &lhs;
+        }
+        break;
+    default:
+        break;
+    }
+    return nullptr;
+}
+
+
+static NodeId write_node(Ast &dst, const Simplified &x) {
+    return x.is_const() ? dst.add_value(x.value) : x.id;
+}
+
+
+static Simplified simplify_unary(const AstNode &node, OpCode op, const Simplified &child, Ast &dst) {
+    if (child.is_const()) {
+        if (stats_enabled()) {
+            record_op_calls(op);
+        }
+        return Simplified::of_const(apply_unary(op, child.value));
+    }
+    // +x is 0 + x, which turns -0.0 into 0.0
+    if (op == OpCode::POS && child.type == StaticType::INT) {
+        return child;
+    }
+
+    NodeId ans = dst.add_operator(node.type);
+    dst.add_child(ans, child.id);
+    return {ans, Value::of_int(0), child.type};
+}
+
+
+static Simplified simplify_binary(
+    const AstNode &node, OpCode op, const Simplified &lhs, const Simplified &rhs, Ast &dst)
+{
+    if (lhs.is_const() && rhs.is_const()) {
+        if (stats_enabled()) {
+            record_op_calls(op);
+        }
+        return Simplified::of_const(apply_binary(op, lhs.value, rhs.value));
+    }
+    const Simplified *same = find_identity(op, lhs, rhs);
+    if (same) {
+        return *same;
+    }
+
+    NodeId lhs_id = write_node(dst, lhs);
+    NodeId rhs_id = write_node(dst, rhs);
+    NodeId ans = dst.add_operator(node.type);
+    dst.add_child(ans, lhs_id);
+    dst.add_child(ans, rhs_id);
+    return {ans, Value::of_int(0), result_type(op, lhs.type, rhs.type)};
+}
+
+
+// walks src without recursion, the simplified operands wait on a stack
+static Simplified simplify_walk(const Ast &src, NodeId id, Ast &dst) {
+    vector<AstWalkItem> stack;
+    vector<Simplified> done;
+    walk_ast(
+        src, id, stack,
+        [](NodeId, const AstNode &node) {
+            node_opcode(node);
+            return true;
+        },
+        [&](NodeId, const AstNode &node) {
+            if (node.type == TokenType::NAME) {
+                NodeId var = dst.add_variable(src.var_names[node.slot]);
+                done.push_back({var, Value::of_int(0), StaticType::ANY});
+                return;
+            }
+            if (node.is_value()) {
+                done.push_back(Simplified::of_const(node.value));
+                return;
+            }
+
+            OpCode op = node_opcode(node);
+            if (node.nchildren == 1) {
+                done.back() = simplify_unary(node, op, done.back(), dst);
+            } else {
+                Simplified rhs = done.back();
+                done.pop_back();
+                done.back() = simplify_binary(node, op, done.back(), rhs, dst);
+            }
+        });
+
+    assert(done.size() == 1);
+    return done.back();
+}
+
+
+// subtrees below MAX_AST_RECURSION are left to simplify_walk()
+static Simplified simplify_node(const Ast &src, NodeId id, Ast &dst, size_t depth) {
+    const AstNode &node = src[id];
+    if (node.type == TokenType::NAME) {
+        return {dst.add_variable(src.var_names[node.slot]), Value::of_int(0), StaticType::ANY};
+    }
+    if (node.is_value()) {
+        return Simplified::of_const(node.value);
+    }
+    if (depth == MAX_AST_RECURSION) {
+        return simplify_walk(src, id, dst);
+    }
+
+    OpCode op = node_opcode(node);
+    if (node.nchildren == 1) {
+        return simplify_unary(node, op, simplify_node(src, node.children[0], dst, depth + 1), dst);
+    }
+    Simplified lhs = simplify_node(src, node.children[0], dst, depth + 1);
+    Simplified rhs = simplify_node(src, node.children[1], dst, depth + 1);
+    return simplify_binary(node, op, lhs, rhs, dst);
+}
+
+
+void simplify_ast(const Ast &src, Ast &dst) {
+    assert(&src != &dst);
+    dst.clear();
+    // keep the slots of src, even for variables that are simplified away
+    dst.var_names = src.var_names;
+    dst.var_slots = src.var_slots;
+    if (!src.empty()) {
+        dst.root = write_node(dst, simplify_node(src, src.root, dst, 0));
+    }
+}
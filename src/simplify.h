@@ -0,0 +1,17 @@
+#ifndef CALCXX_SIMPLIFY_H
+#define CALCXX_SIMPLIFY_H
+
+
+#include "ast.h"
+
+
+/*
+ * Writes to dst a simplified copy of src that evaluates to the same Value:
+ * constant subtrees are folded with apply_unary()/apply_binary(), and
+ * identities like x * 1 are removed when they are exact for the type of x.
+ * Throws the same errors as eval_ast() for malformed operators.
+ */
+void simplify_ast(const Ast &src, Ast &dst);
+
+
+#endif //CALCXX_SIMPLIFY_H
@@ -0,0 +1,125 @@
+#ifndef CALCXX_SPSC_RING_H
+#define CALCXX_SPSC_RING_H
+
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+using std::atomic;
+using std::vector;
+
+
+/*
+ * A bounded queue between exactly one producer thread and one consumer
+ * thread, without locks.
+ *
+ * The producer only writes tail and the consumer only writes head, each
+ * on its own cache line, and both keep a cached copy of the other index
+ * so that the shared one is only read when the ring looks full or empty.
+ * The blocking push() and pop() spin for a while and then sleep in
+ * growing steps, which suits stages that hand over large blocks rarely.
+ */
+template<class T>
+class SpscRing {
+public:
+    // capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+        this->slots.resize(size);
+        this->mask = size - 1;
+    }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    size_t capacity() const {
+        return this->slots.size();
+    }
+
+    // producer side, moves from item only if there is room
+    bool try_push(T &item) {
+        size_t tail = this->tail.load(std::memory_order_relaxed);
+        if (tail - this->head_cache == this->slots.size()) {
+            this->head_cache = this->head.load(std::memory_order_acquire);
+            if (tail - this->head_cache == this->slots.size()) {
+                return false;
+            }
+        }
+        this->slots[tail & this->mask] = std::move(item);
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    bool try_pop(T &item) {
+        size_t head = this->head.load(std::memory_order_relaxed);
+        if (head == this->tail_cache) {
+            this->tail_cache = this->tail.load(std::memory_order_acquire);
+            if (head == this->tail_cache) {
+                return false;
+            }
+        }
+        item = std::move(this->slots[head & this->mask]);
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // waits for room
+    void push(T item) {
+        for (size_t attempt = 0; !this->try_push(item); attempt++) {
+            backoff(attempt);
+        }
+    }
+
+    // waits for an item, returns false once the ring is closed and drained
+    bool pop(T &item) {
+        for (size_t attempt = 0; !this->try_pop(item); attempt++) {
+            if (this->closed.load(std::memory_order_acquire)) {
+                // items pushed before close() are visible now
+                return this->try_pop(item);
+            }
+            backoff(attempt);
+        }
+        return true;
+    }
+
+    // producer side, no more pushes follow
+    void close() {
+        this->closed.store(true, std::memory_order_release);
+    }
+
+private:
+    static const size_t CACHE_LINE = 64;
+
+    vector<T> slots;
+    size_t mask;
+    atomic<bool> closed{false};
+
+    alignas(CACHE_LINE) atomic<size_t> head{0};     // next slot to pop
+    size_t tail_cache = 0;                          // consumer's copy of tail
+    alignas(CACHE_LINE) atomic<size_t> tail{0};     // next slot to push
+    size_t head_cache = 0;                          // producer's copy of head
+
+    static void backoff(size_t attempt) {
+        if (attempt < 64) {
+            return;
+        }
+        if (attempt < 128) {
+            std::this_thread::yield();
+            return;
+        }
+        size_t shift = attempt - 128 < 10 ? attempt - 128 : 10;
+        std::this_thread::sleep_for(std::chrono::microseconds(1 << shift));
+    }
+};
+
+
+#endif //CALCXX_SPSC_RING_H
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "stats.h"
+
+
+using std::lock_guard;
+using std::mutex;
+using std::to_string;
+using std::unique_ptr;
+using std::vector;
+
+
+atomic<bool> g_stats_enabled{false};
+static atomic<unsigned> g_sample_period{DEFAULT_SAMPLE_PERIOD};
+
+
+const size_t LatencyHistogram::SUB_BUCKETS;
+const size_t LatencyHistogram::BUCKET_COUNT;
+
+
+size_t LatencyHistogram::bucket_of(uint64_t ns) {
+    if (ns < SUB_BUCKETS) {
+        return ns;
+    }
+    unsigned msb = 63 - __builtin_clzll(ns);
+    if (msb >= MAX_BITS) {
+        return BUCKET_COUNT - 1;
+    }
+    unsigned shift = msb - SUB_BITS;
+    return (shift + 1) * SUB_BUCKETS + (ns >> shift) - SUB_BUCKETS;
+}
+
+
+uint64_t LatencyHistogram::bucket_start(size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    unsigned shift = unsigned(bucket / SUB_BUCKETS - 1);
+    return (uint64_t(SUB_BUCKETS) + bucket % SUB_BUCKETS) << shift;
+}
+
+
+void LatencyHistogram::record(uint64_t ns) {
+    this->buckets[bucket_of(ns)].add(1);
+    this->total.add(1);
+    this->sum_ns.add(ns);
+    if (ns > this->max_ns.get()) {
+        this->max_ns.set(ns);
+    }
+}
+
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        this->buckets[i].add(other.buckets[i].get());
+    }
+    this->total.add(other.total.get());
+    this->sum_ns.add(other.sum_ns.get());
+    this->max_ns.set(std::max(this->max_ns.get(), other.max_ns.get()));
+}
+
+
+void LatencyHistogram::clear() {
+    for (StatCounter &bucket : this->buckets) {
+        bucket.set(0);
+    }
+    this->total.set(0);
+    this->sum_ns.set(0);
+    this->max_ns.set(0);
+}
+
+
+double LatencyHistogram::mean() const {
+    uint64_t count = this->count();
+    return count > 0 ? double(this->sum_ns.get()) / double(count) : 0;
+}
+
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    uint64_t count = this->count();
+    if (count == 0) {
+        return 0;
+    }
+    // the rank of the value, from 1
+    uint64_t rank = uint64_t(p / 100 * double(count) + 0.5);
+    rank = std::min(std::max<uint64_t>(rank, 1), count);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += this->buckets[i].get();
+        if (seen >= rank) {
+            uint64_t end = i + 1 < BUCKET_COUNT ? bucket_start(i + 1) - 1 : this->max();
+            return std::min(end, this->max());
+        }
+    }
+    return this->max();
+}
+
+
+void RuntimeStats::merge(const RuntimeStats &other) {
+    for (size_t i = 0; i < PHASE_COUNT; i++) {
+        this->phases[i].merge(other.phases[i]);
+    }
+    for (size_t i = 0; i < OPCODE_COUNT; i++) {
+        this->op_calls[i].add(other.op_calls[i].get());
+    }
+}
+
+
+void RuntimeStats::clear() {
+    for (LatencyHistogram &phase : this->phases) {
+        phase.clear();
+    }
+    for (StatCounter &calls : this->op_calls) {
+        calls.set(0);
+    }
+}
+
+
+// the stats of live threads, and of exited ones added up
+static mutex g_threads_mutex;
+static vector<RuntimeStats *> g_threads;
+static RuntimeStats g_exited;
+
+// trivially constructed, so reading it needs no initialization check
+static thread_local RuntimeStats *t_stats = nullptr;
+
+
+// registers the stats of the thread, and moves them to g_exited when it exits
+struct ThreadStatsOwner {
+    unique_ptr<RuntimeStats> stats{new RuntimeStats};
+
+    ThreadStatsOwner() {
+        lock_guard<mutex> lock(g_threads_mutex);
+        g_threads.push_back(this->stats.get());
+    }
+
+    ~ThreadStatsOwner() {
+        lock_guard<mutex> lock(g_threads_mutex);
+        g_exited.merge(*this->stats);
+        g_threads.erase(std::find(g_threads.begin(), g_threads.end(), this->stats.get()));
+        t_stats = nullptr;
+    }
+};
+
+
+static RuntimeStats &local_stats() {
+    if (!t_stats) {
+        static thread_local ThreadStatsOwner owner;
+        t_stats = owner.stats.get();
+    }
+    return *t_stats;
+}
+
+
+void enable_stats(bool on, unsigned sample_period) {
+    if (on) {
+        g_sample_period.store(sample_period > 0 ? sample_period : 1);
+    }
+    g_stats_enabled.store(on);
+}
+
+
+bool sample_line() {
+    static thread_local unsigned countdown = 0;
+    if (countdown == 0) {
+        countdown = g_sample_period.load(std::memory_order_relaxed);
+    }
+    return --countdown == 0;
+}
+
+
+void record_phase(Phase phase, uint64_t ns) {
+    local_stats().phases[static_cast<size_t>(phase)].record(ns);
+}
+
+
+void record_op_calls(OpCode op, uint64_t count) {
+    local_stats().op_calls[static_cast<size_t>(op)].add(count);
+}
+
+
+RuntimeStats collect_stats() {
+    lock_guard<mutex> lock(g_threads_mutex);
+    RuntimeStats ans = g_exited;
+    for (const RuntimeStats *stats : g_threads) {
+        ans.merge(*stats);
+    }
+    return ans;
+}
+
+
+void reset_stats() {
+    lock_guard<mutex> lock(g_threads_mutex);
+    g_exited.clear();
+    for (RuntimeStats *stats : g_threads) {
+        stats->clear();
+    }
+}
+
+
+string repr_stats(const RuntimeStats &stats) {
+    char line[200];
+    string ans = "phase latencies of 1 in " + to_string(g_sample_period.load()) + " lines\n";
+    snprintf(line, sizeof(line), "%-10s %10s %10s %10s %10s %10s %10s %10s\n",
+             "phase", "count", "mean ns", "p50", "p90", "p99", "p99.9", "max");
+    ans += line;
+    for (size_t i = 0; i < PHASE_COUNT; i++) {
+        const LatencyHistogram &hist = stats.phases[i];
+        snprintf(line, sizeof(line), "%-10s %10llu %10.0f %10llu %10llu %10llu %10llu %10llu\n",
+                 repr(static_cast<Phase>(i)).data(),
+                 (unsigned long long)hist.count(), hist.mean(),
+                 (unsigned long long)hist.percentile(50), (unsigned long long)hist.percentile(90),
+                 (unsigned long long)hist.percentile(99), (unsigned long long)hist.percentile(99.9),
+                 (unsigned long long)hist.max());
+        ans += line;
+    }
+    ans += "operator calls\n";
+    for (size_t i = 0; i < OPCODE_COUNT; i++) {
+        snprintf(line, sizeof(line), "%-10s %10llu\n",
+                 repr(static_cast<OpCode>(i)).data(), (unsigned long long)stats.op_calls[i].get());
+        ans += line;
+    }
+    return ans;
+}
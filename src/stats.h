@@ -0,0 +1,184 @@
+#ifndef CALCXX_STATS_H
+#define CALCXX_STATS_H
+
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "operators.h"
+
+
+using std::atomic;
+using std::string;
+
+
+/*
+ * A counter written by one thread and read by any, the increments are
+ * plain relaxed loads and stores, not read-modify-write instructions.
+ */
+class StatCounter {
+public:
+    StatCounter() {}
+    StatCounter(const StatCounter &other) : n(other.get()) {}
+    StatCounter &operator=(const StatCounter &other) {
+        this->set(other.get());
+        return *this;
+    }
+
+    uint64_t get() const {
+        return this->n.load(std::memory_order_relaxed);
+    }
+
+    void set(uint64_t value) {
+        this->n.store(value, std::memory_order_relaxed);
+    }
+
+    void add(uint64_t value) {
+        this->set(this->get() + value);
+    }
+
+private:
+    atomic<uint64_t> n{0};
+};
+
+
+/*
+ * Counts of nanosecond durations in log-linear buckets, as HDR histograms
+ * keep them: every power of two range is split into SUB_BUCKETS buckets, so
+ * a value is known to about 3% wherever it is. Durations from 2^MAX_BITS ns
+ * (about 18 minutes) on share the last bucket. Written by one thread.
+ */
+class LatencyHistogram {
+public:
+    static const unsigned SUB_BITS = 5;
+    static const size_t SUB_BUCKETS = size_t(1) << SUB_BITS;
+    static const unsigned MAX_BITS = 40;
+    static const size_t BUCKET_COUNT = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+    void record(uint64_t ns);
+    // adds the counts of other
+    void merge(const LatencyHistogram &other);
+    void clear();
+
+    uint64_t count() const {
+        return this->total.get();
+    }
+
+    uint64_t max() const {
+        return this->max_ns.get();
+    }
+
+    double mean() const;
+    // the highest value of the bucket holding the p-th percentile, p in [0, 100]
+    uint64_t percentile(double p) const;
+
+    static size_t bucket_of(uint64_t ns);
+    // the smallest value in bucket
+    static uint64_t bucket_start(size_t bucket);
+
+private:
+    StatCounter buckets[BUCKET_COUNT];
+    StatCounter total;
+    StatCounter sum_ns;
+    StatCounter max_ns;
+};
+
+
+// phases of evaluating a line
+enum class Phase : uint8_t {
+    tokenize,
+    parse,      // feeding tokens to the evaluator, TokensEvaluator also evaluates then
+    evaluate,   // getting the result once the END token is fed
+
+    COUNT,
+};
+
+
+static const size_t PHASE_COUNT = static_cast<size_t>(Phase::COUNT);
+
+
+REPR(Phase) {
+    const char *names[] = {"tokenize", "parse", "evaluate"};
+    return value < Phase::COUNT ? names[static_cast<size_t>(value)] : "COUNT";
+}
+
+
+struct RuntimeStats {
+    LatencyHistogram phases[PHASE_COUNT];
+    // operators applied by the evaluators and by constant folding, counted
+    // per tree or program outside the kernels, the JIT and the batch kernels
+    // of columns are not counted
+    StatCounter op_calls[OPCODE_COUNT];
+
+    void merge(const RuntimeStats &other);
+    void clear();
+};
+
+
+/*
+ * While stats are enabled, each thread collects them in RuntimeStats of its
+ * own, which collect_stats() adds up, including those of exited threads.
+ * Enable them before starting the threads that should be counted.
+ *
+ * Reading the clock costs more than evaluating a short line's operators, so
+ * only one line in sample_period of each thread is timed. Operators are
+ * counted on every line.
+ */
+static const unsigned DEFAULT_SAMPLE_PERIOD = 16;
+
+// the period is kept when disabling, for repr_stats()
+void enable_stats(bool on, unsigned sample_period = DEFAULT_SAMPLE_PERIOD);
+
+extern atomic<bool> g_stats_enabled;
+
+inline bool stats_enabled() {
+    return g_stats_enabled.load(std::memory_order_relaxed);
+}
+
+// true for one call in sample_period on each thread
+bool sample_line();
+void record_phase(Phase phase, uint64_t ns);
+// the evaluators call it for the operators they apply, only while stats are enabled
+void record_op_calls(OpCode op, uint64_t count = 1);
+RuntimeStats collect_stats();
+// zeroes the stats of all threads
+void reset_stats();
+
+// a table of the sampled phase latencies and the operator counts
+string repr_stats(const RuntimeStats &stats);
+
+
+/*
+ * Records the time since the previous lap, or since construction, as the
+ * duration of a phase. Does nothing unless stats were enabled when it was
+ * constructed and its line is sampled.
+ */
+class PhaseTimer {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    PhaseTimer() : enabled(stats_enabled() && sample_line()) {
+        if (this->enabled) {
+            this->last = Clock::now();
+        }
+    }
+
+    void lap(Phase phase) {
+        if (this->enabled) {
+            Clock::time_point now = Clock::now();
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - this->last);
+            record_phase(phase, uint64_t(elapsed.count()));
+            this->last = now;
+        }
+    }
+
+private:
+    bool enabled;
+    Clock::time_point last;
+};
+
+
+#endif //CALCXX_STATS_H
@@ -0,0 +1,212 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include "catch.hpp"
+
+#include "../batch.h"
+#include "../calculator.h"
+
+
+using std::string;
+
+
+static FILE *file_with(const string &content) {
+    FILE *file = tmpfile();
+    fwrite(content.data(), 1, content.size(), file);
+    rewind(file);
+    return file;
+}
+
+
+static string file_content(FILE *file) {
+    string ans;
+    rewind(file);
+    char buf[256];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        ans.append(buf, n);
+    }
+    fclose(file);
+    return ans;
+}
+
+
+TEST_CASE("Test Calculator") {
+    for (EvalMode mode : {EvalMode::ast, EvalMode::bytecode, EvalMode::tokens}) {
+        Calculator calc(mode);
+        LineResult result = calc.eval_line("2 * (3 + 4)");
+        CHECK(result.status == LineStatus::ok);
+        CHECK(result.value == Value::of_int(14));
+
+        CHECK(calc.eval_line("  ").status == LineStatus::blank);
+
+        result = calc.eval_line("1 + #");
+        CHECK(result.status == LineStatus::error);
+        CHECK(result.error == "TokenizerError: Unknown char: #");
+        CHECK(result.start == SourcePos(0, 4));
+
+        result = calc.eval_line("1 + xy");
+        CHECK(result.status == LineStatus::error);
+        CHECK(result.error == "EvalError: unbound variable: xy");
+        CHECK(result.start == SourcePos(0, 4));
+        CHECK(result.end == SourcePos(0, 5));
+
+        result = calc.eval_line("(1");
+        CHECK(result.status == LineStatus::error);
+        CHECK(result.error.back() != '\n');
+
+        // the calculator recovers after errors
+        CHECK(calc.eval_line("3 / 2").value == Value::of_float(1.5));
+    }
+}
+
+
+TEST_CASE("Test Calculator deep lines") {
+    const size_t depth = 100000;
+    string line;
+    for (size_t i = 0; i < depth; i++) {
+        line += "1 - (";
+    }
+    line += "2" + string(depth, ')') + " / 4";
+
+    for (EvalMode mode : {EvalMode::ast, EvalMode::bytecode, EvalMode::tokens}) {
+        Calculator calc(mode);
+        LineResult result = calc.eval_line(line);
+        CHECK(result.status == LineStatus::ok);
+        CHECK(result.value == Value::of_float(1.25));
+    }
+}
+
+
+TEST_CASE("Test Calculator cache") {
+    for (EvalMode mode : {EvalMode::ast, EvalMode::bytecode, EvalMode::tokens}) {
+        Calculator calc(mode, 16);
+        const ResultCache &cache = calc.result_cache();
+        CHECK(calc.eval_line("2 * (3 + 4)").value == Value::of_int(14));
+        CHECK(cache.misses() == 1);
+        CHECK(cache.size() == 2);
+
+        // the same text, then the same tokens with other whitespace
+        CHECK(calc.eval_line("2 * (3 + 4)").value == Value::of_int(14));
+        CHECK(cache.hits() == 1);
+        CHECK(calc.eval_line("2*(3+4)  ").value == Value::of_int(14));
+        CHECK(cache.hits() == 2);
+        CHECK(cache.misses() == 1);
+        CHECK(calc.eval_line("2*(3+4)  ").value == Value::of_int(14));
+        CHECK(cache.hits() == 3);
+        CHECK(calc.eval_line("2 * (3 + 4.0)").value == Value::of_float(14.0));
+        CHECK(cache.size() == 5);
+
+        // errors keep their position and are not cached
+        for (const char *line : {"1 + xy", "  1 + xy", "1 + xy"}) {
+            LineResult result = calc.eval_line(line);
+            CHECK(result.status == LineStatus::error);
+            CHECK(result.start.rowno == int(string(line).find('x')));
+        }
+        CHECK(calc.eval_line("   ").status == LineStatus::blank);
+        CHECK(cache.size() == 5);
+        CHECK(cache.hits() == 3);
+        // each line with tokens once
+        CHECK(cache.misses() == 5);
+    }
+
+    string text;
+    Calculator calc(EvalMode::ast, 16);
+    calc.eval_line("1 + 2");
+    CHECK(calc.dump_line("1 + 2", text).value == Value::of_int(3));
+    CHECK(text.find("simplified:") != string::npos);
+    CHECK(calc.result_cache().hits() == 0);
+}
+
+
+TEST_CASE("Test run_batch") {
+    FILE *out = tmpfile();
+    FILE *err = tmpfile();
+    size_t failed = run_batch(EvalMode::ast, file_with("1 + 2\n\n2 *\n 3 / 2\n4"), out, err);
+    CHECK(failed == 1);
+    CHECK(file_content(out) == "3\n1.500000\n4\n");
+    CHECK(file_content(err).find("line 3, col 4: ParserError: ") == 0);
+}
+
+
+TEST_CASE("Test run_batch long lines") {
+    // lines longer than the read block
+    string line = "1" + string(1500000, ' ') + "+ 2";
+    FILE *out = tmpfile();
+    FILE *err = tmpfile();
+    CHECK(run_batch(EvalMode::bytecode, file_with(line + "\n" + line), out, err) == 0);
+    CHECK(file_content(out) == "3\n3\n");
+    CHECK(file_content(err) == "");
+}
+
+
+TEST_CASE("Test run_batch_file") {
+    char path[] = "/tmp/calcxx_test_XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    string content = "1 + 2\n\n2 *\n 3 / 2\n4";
+    CHECK(write(fd, content.data(), content.size()) == (ssize_t)content.size());
+    close(fd);
+
+    FILE *out = tmpfile();
+    FILE *err = tmpfile();
+    CHECK(run_batch_file(EvalMode::tokens, path, out, err) == 1);
+    CHECK(file_content(out) == "3\n1.500000\n4\n");
+    CHECK(file_content(err).find("line 3, col 4: ") == 0);
+    unlink(path);
+
+    CHECK_THROWS_AS(MappedFile("/nonexistent/calcxx"), const IOError &);
+    CHECK_THROWS_AS(run_batch_file(EvalMode::ast, "/nonexistent/calcxx", stdout, stderr), const IOError &);
+}
+
+
+TEST_CASE("Test run_batch threads") {
+    string content;
+    for (int i = 0; i < 100000; i++) {
+        if (i % 97 == 0) {
+            content += "1 + x\n";
+        } else if (i % 89 == 0) {
+            content += "\n";
+        } else {
+            content += std::to_string(i) + " / 7 - (3 * 2.5)\n";
+        }
+    }
+    content += "1" + string(600000, ' ') + "+ 2\n42";
+
+    FILE *out = tmpfile();
+    FILE *err = tmpfile();
+    size_t failed = run_batch(EvalMode::bytecode, file_with(content), out, err);
+    string expected_out = file_content(out);
+    string expected_err = file_content(err);
+    CHECK(failed == 1031);
+
+    for (size_t threads : {2, 3, 8}) {
+        out = tmpfile();
+        err = tmpfile();
+        CHECK(run_batch(EvalMode::bytecode, file_with(content), out, err, threads) == failed);
+        CHECK(file_content(out) == expected_out);
+        CHECK(file_content(err) == expected_err);
+    }
+    for (size_t threads : {1, 3}) {
+        out = tmpfile();
+        err = tmpfile();
+        CHECK(run_batch(EvalMode::bytecode, file_with(content), out, err, threads, 100) == failed);
+        CHECK(file_content(out) == expected_out);
+        CHECK(file_content(err) == expected_err);
+    }
+
+    char path[] = "/tmp/calcxx_test_XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    CHECK(write(fd, content.data(), content.size()) == (ssize_t)content.size());
+    close(fd);
+    for (size_t threads : {1, 4}) {
+        out = tmpfile();
+        err = tmpfile();
+        CHECK(run_batch_file(EvalMode::bytecode, path, out, err, threads) == failed);
+        CHECK(file_content(out) == expected_out);
+        CHECK(file_content(err) == expected_err);
+    }
+    unlink(path);
+}
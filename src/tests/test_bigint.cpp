@@ -0,0 +1,107 @@
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include "catch.hpp"
+
+#include "../bigint.h"
+
+
+using std::mt19937_64;
+using std::string;
+
+
+static string int128_string(__int128 v) {
+    bool negative = v < 0;
+    unsigned __int128 mag = negative ? -static_cast<unsigned __int128>(v) : v;
+    string digits;
+    do {
+        digits.insert(digits.begin(), char('0' + int(mag % 10)));
+        mag /= 10;
+    } while (mag);
+    return negative ? "-" + digits : digits;
+}
+
+
+// n random decimal digits without a leading zero
+static string random_digits(mt19937_64 &rng, size_t n) {
+    string digits(1, char('1' + rng() % 9));
+    while (digits.size() < n) {
+        digits += char('0' + rng() % 10);
+    }
+    return digits;
+}
+
+
+TEST_CASE("Test BigInt matches int64") {
+    mt19937_64 rng(17);
+    size_t mismatches = 0;
+    for (int i = 0; i < 20000; i++) {
+        int64_t a = int64_t(rng()) >> (rng() % 64);
+        int64_t b = int64_t(rng()) >> (rng() % 64);
+        BigInt x(a), y(b);
+
+        mismatches += (x + y).to_string() != int128_string(__int128(a) + b);
+        mismatches += (x - y).to_string() != int128_string(__int128(a) - b);
+        mismatches += (x * y).to_string() != int128_string(__int128(a) * b);
+        if (b != 0 && !(a == INT64_MIN && b == -1)) {
+            BigInt quot, rem;
+            BigInt::divmod(x, y, quot, rem);
+            mismatches += quot.to_string() != int128_string(a / b);
+            mismatches += rem.to_string() != int128_string(a % b);
+        }
+        mismatches += !x.fits_int64() || x.to_int64() != a;
+        mismatches += x.to_double() != static_cast<double>(a);
+    }
+    CHECK(mismatches == 0);
+}
+
+
+TEST_CASE("Test BigInt large") {
+    mt19937_64 rng(3);
+    // sizes in limbs around the schoolbook and Karatsuba cutoff
+    for (size_t limbs : {1, 5, 39, 40, 41, 80, 100, 333, 1000, 2500}) {
+        string da = random_digits(rng, limbs * 9);
+        string db = random_digits(rng, limbs * 9 * (1 + rng() % 3) / 3);
+        BigInt a = BigInt::from_digits(da);
+        BigInt b = BigInt::from_digits(db);
+        INFO(limbs << " limbs");
+
+        CHECK(a.to_string() == da);
+        CHECK((-b).to_string() == "-" + db);
+        CHECK((a + b) * (a - b) == a * a - b * b);
+
+        BigInt quot, rem;
+        BigInt::divmod(a * b + b - BigInt(1), b, quot, rem);
+        CHECK(quot == a);
+        CHECK(rem == b - BigInt(1));
+        BigInt::divmod(-a, b, quot, rem);
+        CHECK(quot * b + rem == -a);
+        CHECK((rem.is_zero() || rem.is_negative()));
+    }
+}
+
+
+TEST_CASE("Test BigInt conversions") {
+    BigInt max(INT64_MAX);
+    BigInt min(INT64_MIN);
+    CHECK(min.fits_int64());
+    CHECK_FALSE((max + BigInt(1)).fits_int64());
+    CHECK_FALSE((min - BigInt(1)).fits_int64());
+    CHECK((-min).to_string() == "9223372036854775808");
+    CHECK(BigInt::from_digits("000").is_zero());
+    CHECK(BigInt::from_digits("0007").to_string() == "7");
+    CHECK(BigInt(0).to_string() == "0");
+    CHECK((-BigInt(0)) == BigInt());
+
+    CHECK(BigInt::from_digits("123456789012345678901234567890").to_double()
+        == 123456789012345678901234567890.0);
+    // (2^53 + 1) * 2^40 is halfway between two doubles and rounds to even,
+    // a nonzero bit further down rounds up
+    CHECK(BigInt::from_digits("9903520314283043298704621568").to_double() == 0x1p93);
+    CHECK(BigInt::from_digits("9903520314283043298704621569").to_double() == 0x1.0000000000001p93);
+    CHECK(BigInt::from_digits(string(400, '9')).to_double() == HUGE_VAL);
+    CHECK(BigInt::div_to_double(
+        BigInt::from_digits("1000000000000000000000000000001"),
+        BigInt::from_digits("3000000000000000000000000000000")) == 1.0 / 3);
+}
@@ -0,0 +1,102 @@
+#include <cstdint>
+#include <string>
+#include "catch.hpp"
+
+#include "../bytecode.h"
+#include "../eval_ast.h"
+#include "../ast.h"
+#include "../parser.h"
+#include "../tokenizer.h"
+#include "../tokens.h"
+
+
+using std::string;
+
+
+static Ast parse_string(const string &str) {
+    Tokenizer tokenizer;
+    for (size_t i = 0; i <= str.size(); i++) {
+        tokenizer.feed(str[i]);
+    }
+
+    Parser parser;
+    Token::Ptr tok;
+    while ((tok = tokenizer.pop())) {
+        parser.feed(tok);
+    }
+    return parser.get_result();
+}
+
+
+static Value run_string(const string &str) {
+    VM vm;
+    return vm.run(compile_ast(parse_string(str)));
+}
+
+
+TEST_CASE("Test compile_ast") {
+    Program prog = compile_ast(parse_string("1 + 2 * 3"));
+    CHECK(repr_program(prog) ==
+        "PUSH 0 ; 1\n"
+        "PUSH 1 ; 2\n"
+        "PUSH 2 ; 3\n"
+        "BINARY MULT\n"
+        "BINARY ADD\n"
+    );
+    CHECK(prog.max_depth == 3);
+
+    prog = compile_ast(parse_string("1 + 2 * 3 + 4"));
+    REQUIRE(prog.op_counts.size() == 2);
+    CHECK(prog.op_counts[0].op == OpCode::ADD);
+    CHECK(prog.op_counts[0].count == 2);
+    CHECK(prog.op_counts[1].op == OpCode::MULT);
+    CHECK(prog.op_counts[1].count == 1);
+
+    prog = compile_ast(parse_string("-(1)"));
+    CHECK(repr_program(prog) == "PUSH 0 ; 1\nUNARY NEG\n");
+    CHECK(prog.max_depth == 1);
+}
+
+
+TEST_CASE("Test VM") {
+    CHECK(run_string("1") == Value::of_int(1));
+    CHECK(run_string("1 + 1") == Value::of_int(2));
+    CHECK(run_string("-5 - 1 + 2 * 3") == Value::of_int(0));
+    CHECK(run_string("3 / 2") == Value::of_float(1.5));
+    CHECK(run_string("(3 + ((3 + 4 / 2) - 1)) * 2") == Value::of_int(14));
+
+    for (string str : {"1.5 * 2 - (-3)", "+4 / (2 - 2)", "((((((2))))))", "1 - 2 + 3 * 4 / 5"}) {
+        CHECK(run_string(str) == eval_ast(parse_string(str)));
+    }
+}
+
+
+TEST_CASE("Test VM reuse") {
+    VM vm;
+    Program prog = compile_ast(parse_string("2 * (3 + 4)"));
+    for (int i = 0; i < 3; i++) {
+        CHECK(vm.run(prog) == Value::of_int(14));
+    }
+    CHECK(vm.run(compile_ast(parse_string("1 + 2 + 3 + 4"))) == Value::of_int(10));
+}
+
+
+TEST_CASE("Test compile deep") {
+    const size_t depth = 100000;
+    string left = "1";
+    string right;
+    for (size_t i = 0; i < depth; i++) {
+        left += " - 1";
+        right += "1 - (";
+    }
+    right += "1" + string(depth, ')');
+
+    Program prog = compile_ast(parse_string(left));
+    CHECK(prog.code.size() == 2 * depth + 1);
+    CHECK(prog.max_depth == 2);
+    CHECK(VM().run(prog) == Value::of_int(1 - int64_t(depth)));
+
+    prog = compile_ast(parse_string(right));
+    CHECK(prog.max_depth == depth + 1);
+    CHECK(VM().run(prog) == Value::of_int(depth % 2 == 0 ? 1 : 0));
+}
@@ -0,0 +1,138 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+
+#include "../columns.h"
+#include "../exception.h"
+#include "../formula.h"
+
+
+using std::mt19937_64;
+using std::string;
+using std::vector;
+
+
+// evaluates every row with Formula and compares
+static void check_rows(const string &text, const vector<Column> &columns, size_t rows) {
+    ColumnFormula cf(text);
+    vector<Value> out(rows);
+    cf.eval(columns, rows, out.data());
+
+    Formula f(text);
+    VM vm;
+    vector<Value> vars(f.var_count());
+    size_t mismatches = 0;
+    for (size_t row = 0; row < rows; row++) {
+        for (size_t slot = 0; slot < vars.size(); slot++) {
+            const string &name = f.var_names()[slot];
+            const Column &col = columns[std::stoul(name.substr(1))];
+            vars[slot] = col.type == ValueType::INT
+                ? Value::of_int(static_cast<const int64_t *>(col.data)[row])
+                : Value::of_float(static_cast<const double *>(col.data)[row]);
+        }
+        Value expected = f.eval(vars, vm);
+        if (!(out[row] == expected)) {
+            mismatches++;
+        }
+    }
+    INFO(text << " over " << rows << " rows");
+    CHECK(mismatches == 0);
+}
+
+
+TEST_CASE("Test ColumnFormula matches Formula") {
+    mt19937_64 rng(5);
+    size_t rows = 3 * BATCH_SIZE + 17;
+    vector<int64_t> ints1(rows), ints2(rows);
+    vector<double> floats(rows);
+    for (size_t i = 0; i < rows; i++) {
+        ints1[i] = int64_t(rng() % 2001) - 1000;
+        ints2[i] = int64_t(rng() % 21) - 10;
+        floats[i] = (int64_t(rng() % 20001) - 10000) / 64.0;
+    }
+    vector<Column> columns = {
+        Column::of_ints(ints1.data()), Column::of_ints(ints2.data()), Column::of_floats(floats.data()),
+    };
+
+    for (string text : {
+        "$0", "$2", "-$0", "+$2", "$0 + $1", "$0 - $2 * 3", "($0 + 1.5) * ($1 - $0)",
+        "$0 / $1", "$2 / $1", "$1 / $2", "$2 / ($2 - $2)", "$0 * $1 / 2", "-($0 * 4) / 2",
+        "1 + 2 * 3", "$2 * 1 - 0", "$1 / $1 + $0",
+        "($0 * $1 + $2) * ($0 * $1 + $2) - ($0 * $1 + $2) / 2", "($0 - $1) / ($0 - $1) + $0 / $1",
+    }) {
+        for (size_t n : {rows, size_t(BATCH_SIZE), size_t(5), size_t(0)}) {
+            check_rows(text, columns, n);
+        }
+    }
+}
+
+
+TEST_CASE("Test ColumnFormula division types") {
+    vector<int64_t> a = {6, 9, -4, 7};
+    vector<int64_t> b = {3, 3, 2, 2};
+    vector<Column> columns = {Column::of_ints(a.data()), Column::of_ints(b.data())};
+    ColumnFormula cf("$0 / $1");
+    vector<Value> out(4);
+
+    // every row exact
+    cf.eval(columns, 3, out.data());
+    CHECK(out[0] == Value::of_int(2));
+    CHECK(out[1] == Value::of_int(3));
+    CHECK(out[2] == Value::of_int(-2));
+
+    // 7 / 2 is not, the block is evaluated row by row
+    cf.eval(columns, 4, out.data());
+    CHECK(out[0] == Value::of_int(2));
+    CHECK(out[3] == Value::of_float(3.5));
+}
+
+
+TEST_CASE("Test ColumnFormula int overflow") {
+    size_t rows = BATCH_SIZE + 3;
+    vector<int64_t> a(rows, INT64_MAX - 1);
+    vector<int64_t> b(rows, -1);
+    vector<Column> columns = {Column::of_ints(a.data()), Column::of_ints(b.data())};
+    for (string text : {"$0 - $1", "$0 * $1 * 2", "-($0 * $1) - 1", "($0 * $1 - 1) / $1"}) {
+        check_rows(text, columns, rows);
+    }
+
+    // a block with one overflowing row
+    b[BATCH_SIZE + 1] = 2;
+    for (string text : {"$0 + $1", "$0 * $1", "-$0 - $1 - 2"}) {
+        check_rows(text, columns, rows);
+    }
+    ColumnFormula cf("$0 + $1");
+    vector<Value> out(rows);
+    cf.eval(columns, rows, out.data());
+    CHECK(out[BATCH_SIZE] == Value::of_int(INT64_MAX - 2));
+    CHECK(out[BATCH_SIZE + 1] == Value::of_big(BigInt(INT64_MAX) + BigInt(1)));
+
+    // INT64_MIN / -1 and BIG constants
+    a[3] = INT64_MIN;
+    for (string text : {"$0 / $1", "$0 * 100000000000000000000 / 100000000000000000000"}) {
+        check_rows(text, columns, rows);
+    }
+    ColumnFormula big("$0 / $1 + 10000000000000000000");
+    big.eval(columns, rows, out.data());
+    CHECK(out[0] == Value::of_big(BigInt::from_digits("10000000000000000000") - BigInt(INT64_MAX - 1)));
+    CHECK(out[3] == Value::of_big(BigInt::from_digits("19223372036854775808")));
+}
+
+
+TEST_CASE("Test ColumnFormula columns") {
+    ColumnFormula cf("$3 - $1 * $3");
+    CHECK(cf.column_count() == 4);
+
+    vector<int64_t> data = {1, 2};
+    Column col = Column::of_ints(data.data());
+    vector<Value> out(2);
+    cf.eval({col, col, col, col}, 2, out.data());
+    CHECK(out[1] == Value::of_int(-2));
+    CHECK_THROWS_AS(cf.eval({col, col, col}, 2, out.data()), const ArgumentError &);
+
+    CHECK_THROWS_AS(ColumnFormula("$0 + x"), const ArgumentError &);
+    CHECK_THROWS_AS(ColumnFormula("$99999999999999999999999"), const ArgumentError &);
+    CHECK(ColumnFormula("2 * 3").column_count() == 0);
+}
@@ -1,4 +1,3 @@
-#include <memory>
 #include "catch.hpp"
 
 #include "../tokens.h"
@@ -6,31 +5,9 @@
 #include "../eval.h"
 
 
-using std::make_shared;
 using namespace Catch::Matchers;
 
 
-TEST_CASE("Test extract argument") {
-    stack<Token::Ptr> input;
-    vector<Token::Ptr> output;
-
-    CHECK(extract_argument(input, {}).size() == 0);
-    CHECK_THROWS_WITH(extract_argument(input, {"i"}), Contains("missing"));
-
-    input.push(make_shared<TokenInt>(1));
-    input.push(make_shared<TokenFloat>(2.0));
-    output = extract_argument(input, {"f", "i"});
-    REQUIRE(output.size() == 2);
-    REQUIRE(input.size() == 0);
-    CHECK(*output[0] == TokenInt(1));
-    CHECK(*output[1] == TokenFloat(2.0));
-
-    input.push(make_shared<TokenInt>(1));
-    input.push(make_shared<TokenInt>(2));
-    CHECK_THROWS_WITH(extract_argument(input, {"if", "f"}), Contains("mismatch"));
-}
-
-
 vector<Token::Ptr> get_tokens(const string &str) {
     Tokenizer tokenizer;
     for (char ch : str) {
@@ -46,7 +23,7 @@ vector<Token::Ptr> get_tokens(const string &str) {
 }
 
 
-Token::Ptr eval_string_token_by_token(const string &input) {
+Value eval_string_token_by_token(const string &input) {
     auto tokenizer = Tokenizer();
     auto calc = TokensEvaluator();
     for (size_t i = 0; i <= input.size(); i++) {    // including \0
@@ -62,15 +39,32 @@ Token::Ptr eval_string_token_by_token(const string &input) {
 
 
 TEST_CASE("Test TokensEvalator") {
-    CHECK(*eval_string_token_by_token("1 + 1") == TokenInt(2));
-    CHECK(*eval_string_token_by_token("1 + 1 + 2") == TokenInt(4));
-    CHECK(*eval_string_token_by_token("1 + 2*3") == TokenInt(7));
-    CHECK(*eval_string_token_by_token("2*2 + 3") == TokenInt(7));
-    CHECK(*eval_string_token_by_token("2") == TokenInt(2));
-    CHECK(*eval_string_token_by_token("(2)") == TokenInt(2));
-    CHECK(*eval_string_token_by_token("(3 + 4)") == TokenInt(7));
-    CHECK(*eval_string_token_by_token("2 * (3 + 4)") == TokenInt(14));
-    CHECK(*eval_string_token_by_token("(3 + 4) * 2") == TokenInt(14));
-    CHECK(*eval_string_token_by_token("(3 + ((3 + 4 / 2) - 1)) * 2") == TokenInt(14));
-    CHECK(*eval_string_token_by_token("((((((2))))))") == TokenInt(2));
+    CHECK(eval_string_token_by_token("1 + 1") == Value::of_int(2));
+    CHECK(eval_string_token_by_token("1 + 1 + 2") == Value::of_int(4));
+    CHECK(eval_string_token_by_token("1 + 2*3") == Value::of_int(7));
+    CHECK(eval_string_token_by_token("2*2 + 3") == Value::of_int(7));
+    CHECK(eval_string_token_by_token("2") == Value::of_int(2));
+    CHECK(eval_string_token_by_token("(2)") == Value::of_int(2));
+    CHECK(eval_string_token_by_token("(3 + 4)") == Value::of_int(7));
+    CHECK(eval_string_token_by_token("2 * (3 + 4)") == Value::of_int(14));
+    CHECK(eval_string_token_by_token("(3 + 4) * 2") == Value::of_int(14));
+    CHECK(eval_string_token_by_token("(3 + ((3 + 4 / 2) - 1)) * 2") == Value::of_int(14));
+    CHECK(eval_string_token_by_token("((((((2))))))") == Value::of_int(2));
+}
+
+
+TEST_CASE("Test TokensEvalator big") {
+    Value big = eval_string_token_by_token("9223372036854775807 + 1");
+    CHECK(big.type == ValueType::BIG);
+    CHECK(repr(big) == "9223372036854775808");
+    CHECK(repr(eval_string_token_by_token("1 - 100000000000000000000 * 100000000000000000000"))
+        == "-" + string(40, '9'));
+    CHECK(eval_string_token_by_token("99999999999999999999 - 99999999999999999990") == Value::of_int(9));
+    CHECK(eval_string_token_by_token("100000000000000000000 / 16") == Value::of_int(6250000000000000000));
+}
+
+
+TEST_CASE("Test TokensEvalator missing argument") {
+    CHECK_THROWS_WITH(eval_string_token_by_token("1 +"), Contains("missing"));
+    CHECK_THROWS_WITH(eval_string_token_by_token("* 2"), Contains("missing"));
 }
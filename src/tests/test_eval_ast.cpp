@@ -2,7 +2,8 @@
 #include "catch.hpp"
 
 #include "../eval_ast.h"
-#include "../node.h"
+#include "../ast.h"
+#include "../exception.h"
 #include "../parser.h"
 #include "../tokenizer.h"
 #include "../tokens.h"
@@ -11,7 +12,7 @@
 using std::string;
 
 
-Token::Ptr eval_string(const string &str) {
+Value eval_string(const string &str) {
     Tokenizer tokenizer;
     for (size_t i = 0; i <= str.size(); i++) {
         tokenizer.feed(str[i]);
@@ -23,13 +24,40 @@ Token::Ptr eval_string(const string &str) {
         parser.feed(tok);
     }
 
-    Node::Ptr ast = parser.get_result();
-    return eval_node(ast);
+    return eval_ast(parser.get_result());
 }
 
 
 TEST_CASE("Test eval_node") {
-    CHECK(*eval_string("1") == TokenInt(1));
-    CHECK(*eval_string("1 + 1") == TokenInt(2));
-    CHECK(*eval_string("-5 - 1 + 2 * 3") == TokenInt(0));
+    CHECK(eval_string("1") == Value::of_int(1));
+    CHECK(eval_string("1 + 1") == Value::of_int(2));
+    CHECK(eval_string("-5 - 1 + 2 * 3") == Value::of_int(0));
+}
+
+
+// deep enough to overflow the native stack of a recursive evaluation
+static const size_t DEEP = 200000;
+
+
+TEST_CASE("Test eval_node deep") {
+    CHECK(eval_string(string(DEEP, '(') + "7" + string(DEEP, ')')) == Value::of_int(7));
+
+    string left = "0";
+    for (size_t i = 0; i < DEEP; i++) {
+        left += " + 1";
+    }
+    CHECK(eval_string(left) == Value::of_int(DEEP));
+
+    string right;
+    for (size_t i = 0; i < DEEP; i++) {
+        right += "1 + (";
+    }
+    CHECK(eval_string(right + "0.5" + string(DEEP, ')')) == Value::of_float(DEEP + 0.5));
+    CHECK_THROWS_AS(eval_string(right + "x" + string(DEEP, ')')), const EvalError &);
+
+    string negs;
+    for (size_t i = 0; i < DEEP; i++) {
+        negs += "-(";
+    }
+    CHECK(eval_string(negs + "3" + string(DEEP, ')')) == Value::of_int(3));
 }
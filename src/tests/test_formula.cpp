@@ -0,0 +1,96 @@
+#include <string>
+#include <vector>
+#include "catch.hpp"
+
+#include "../eval_ast.h"
+#include "../exception.h"
+#include "../formula.h"
+#include "../parser.h"
+#include "../tokenizer.h"
+
+
+using std::string;
+using std::vector;
+
+
+TEST_CASE("Test Formula slots") {
+    Formula f("b * (a + b) - c / a");
+    CHECK(f.var_count() == 3);
+    CHECK(f.var_names() == vector<string>({"b", "a", "c"}));
+    CHECK(f.slot("b") == 0);
+    CHECK(f.slot("a") == 1);
+    CHECK(f.slot("c") == 2);
+    CHECK(f.slot("d") == Formula::NO_SLOT);
+
+    CHECK(Formula("1 + 2").var_count() == 0);
+}
+
+
+TEST_CASE("Test Formula eval") {
+    Formula f("price * (1 + rate) - 2 * 3");
+    VM vm;
+    vector<Value> vars(f.var_count());
+    vars[f.slot("price")] = Value::of_int(100);
+    vars[f.slot("rate")] = Value::of_float(0.5);
+    CHECK(f.eval(vars, vm) == Value::of_float(144.0));
+
+    // the constant part is folded at compile time
+    CHECK(repr_program(f.get_program()).find("PUSH 0 ; 1\n") != string::npos);
+    CHECK(repr_program(f.get_program()).find("; 6\n") != string::npos);
+
+    for (int64_t i = 0; i < 100; i++) {
+        vars[0] = Value::of_int(i);
+        vars[1] = Value::of_int(i % 7);
+        CHECK(f.eval(vars, vm) == Value::of_int(i * (1 + i % 7) - 6));
+    }
+}
+
+
+TEST_CASE("Test Formula matches eval_ast") {
+    for (string str : {
+        "x", "-x", "x / y", "(x - y) * (x + y) / 2", "+x * 2.0 - y / x",
+        "(x * y + 1) * (x * y + 1) - (x * y + 1)", "x / y - x / y * (x / y)",
+    }) {
+        vector<Token::Ptr> tokens;
+        tokenize(str, tokens);
+        Parser parser;
+        for (const Token::Ptr &tok : tokens) {
+            parser.feed(tok);
+        }
+        const Ast &ast = parser.get_result();
+
+        Formula f(str);
+        VM vm;
+        for (Value x : {Value::of_int(3), Value::of_float(-1.5), Value::of_int(0)}) {
+            for (Value y : {Value::of_int(4), Value::of_float(0.25)}) {
+                vector<Value> vars = {x, y};    // x comes first in every formula
+                CHECK(f.eval(vars, vm) == eval_ast(ast, vars.data()));
+            }
+        }
+    }
+}
+
+
+TEST_CASE("Test Formula errors") {
+    CHECK_THROWS_AS(Formula("x +"), const ParserError &);
+    CHECK_THROWS_AS(Formula("x # 1"), const TokenizerError &);
+
+    Formula f("x + y");
+    VM vm;
+    CHECK_THROWS_AS(f.eval({Value::of_int(1)}, vm), const ArgumentError &);
+}
+
+
+TEST_CASE("Test Formula shares subexpressions") {
+    Formula f("(a * b + c) * 2 + (a * b + c) * 3 - (a * b + c)");
+    CHECK(f.merged_nodes() == 10);
+    string code = repr_program(f.get_program());
+    CHECK(code.find("STORE 0\n") != string::npos);
+    CHECK(code.find("LOAD_TEMP 0\n") != string::npos);
+
+    VM vm;
+    vector<Value> vars = {Value::of_int(2), Value::of_int(3), Value::of_int(4)};
+    CHECK(f.eval(vars, vm) == Value::of_int(40));
+
+    CHECK(Formula("a * b + c").merged_nodes() == 0);
+}
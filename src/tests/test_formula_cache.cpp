@@ -0,0 +1,94 @@
+#include <string>
+#include <thread>
+#include <vector>
+#include "catch.hpp"
+
+#include "../exception.h"
+#include "../formula_cache.h"
+
+
+using std::string;
+using std::thread;
+using std::to_string;
+using std::vector;
+
+
+TEST_CASE("Test FormulaCache get") {
+    FormulaCache cache(100);
+    shared_ptr<const Formula> f = cache.get("x * 2 + y");
+    REQUIRE(f);
+    CHECK(f->var_count() == 2);
+    CHECK(cache.get("x * 2 + y") == f);
+    CHECK(cache.find("x * 2 + y") == f);
+    CHECK_FALSE(cache.find("x * 3 + y"));
+    // keyed by the text, not the tokens
+    CHECK(cache.get("x*2 + y") != f);
+
+    FormulaCache::Stats stats = cache.stats();
+    CHECK(stats.hits == 2);
+    CHECK(stats.misses == 3);
+    CHECK(stats.size == 2);
+    CHECK(stats.evictions == 0);
+
+    CHECK_THROWS_AS(cache.get("x *"), const ParserError &);
+    CHECK_THROWS_AS(cache.get("x # 2"), const TokenizerError &);
+    CHECK(cache.stats().size == 2);
+
+    // a formula outlives its entry
+    cache.clear();
+    CHECK(cache.stats().size == 0);
+    CHECK(cache.stats().hits == 0);
+    VM vm;
+    CHECK(f->eval({Value::of_int(3), Value::of_int(1)}, vm) == Value::of_int(7));
+    CHECK(cache.get("x * 2 + y") != f);
+}
+
+
+TEST_CASE("Test FormulaCache eviction") {
+    FormulaCache cache(FormulaCache::SHARD_COUNT * 2);
+    shared_ptr<const Formula> hot = cache.get("hot + 1");
+    for (int i = 0; i < 1000; i++) {
+        cache.get(to_string(i) + " * x");
+        CHECK(cache.get("hot + 1") == hot);
+    }
+    FormulaCache::Stats stats = cache.stats();
+    CHECK(stats.size == FormulaCache::SHARD_COUNT * 2);
+    CHECK(stats.evictions == 1001 - stats.size);
+    CHECK(stats.hits == 1000);
+
+    FormulaCache tiny(0);
+    tiny.get("1");
+    tiny.get("2");
+    CHECK(tiny.stats().size <= FormulaCache::SHARD_COUNT);
+
+    // entries are only allocated as they are added
+    FormulaCache huge(size_t(1) << 40);
+    huge.get("1");
+    CHECK(huge.stats().size == 1);
+}
+
+
+TEST_CASE("Test FormulaCache threads") {
+    FormulaCache cache(64);
+    vector<thread> threads;
+    vector<size_t> wrong(4);
+    for (size_t t = 0; t < 4; t++) {
+        threads.emplace_back([&cache, &wrong, t]() {
+            VM vm;
+            for (int i = 0; i < 5000; i++) {
+                int k = (i * 7 + int(t)) % 200;
+                shared_ptr<const Formula> f = cache.get("x * " + to_string(k) + " - 1");
+                wrong[t] += !(f->eval({Value::of_int(i)}, vm) == Value::of_int(int64_t(i) * k - 1));
+            }
+        });
+    }
+    for (thread &th : threads) {
+        th.join();
+    }
+    for (size_t count : wrong) {
+        CHECK(count == 0);
+    }
+    FormulaCache::Stats stats = cache.stats();
+    CHECK(stats.hits + stats.misses == 4 * 5000);
+    CHECK(stats.size <= 64);
+}
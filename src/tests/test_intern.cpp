@@ -0,0 +1,165 @@
+#include <random>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+
+#include "../ast.h"
+#include "../bytecode.h"
+#include "../eval_ast.h"
+#include "../exception.h"
+#include "../intern.h"
+#include "../parser.h"
+#include "../simplify.h"
+#include "../tokenizer.h"
+
+
+using std::mt19937_64;
+using std::string;
+using std::vector;
+
+
+static Ast parse_string(const string &str) {
+    vector<Token::Ptr> tokens;
+    tokenize(str, tokens);
+    Parser parser;
+    for (const Token::Ptr &tok : tokens) {
+        parser.feed(tok);
+    }
+    return parser.get_result();
+}
+
+
+TEST_CASE("Test intern_ast") {
+    Ast src = parse_string("(a * b + c) * (a * b + c) - (a * b + c) / a");
+    Ast dag;
+    CHECK(intern_ast(src, dag) == 11);
+    CHECK(dag.nodes.size() == src.nodes.size() - 11);
+    CHECK(dag == src);
+    CHECK(dag.var_names == src.var_names);
+
+    // both operands of the product are the same node
+    const AstNode &lhs = dag[dag[dag.root].children[0]];
+    CHECK(lhs.children[0] == lhs.children[1]);
+
+    // children are written first
+    for (NodeId id = 0; id < dag.nodes.size(); id++) {
+        for (size_t i = 0; i < dag[id].nchildren; i++) {
+            CHECK(dag[id].children[i] < id);
+        }
+    }
+
+    CHECK(intern_ast(parse_string("x - y * 2"), dag) == 0);
+    CHECK(dag.nodes.size() == 5);
+    CHECK(intern_ast(Ast(), dag) == 0);
+    CHECK(dag.empty());
+}
+
+
+TEST_CASE("Test intern_ast values") {
+    Ast dag;
+    // same value, other type or other bits
+    CHECK(intern_ast(parse_string("(1 + x) * (1.0 + x)"), dag) == 1);
+    CHECK(intern_ast(parse_string("2.5 * 2.5 + 2.5"), dag) == 2);
+    string big = "123456789012345678901234567890";
+    CHECK(intern_ast(parse_string(big + " - " + big), dag) == 1);
+    CHECK(intern_ast(parse_string(big + " - " + big + "1"), dag) == 0);
+
+    // simplify_ast() folds the -0.0 constant
+    Ast simplified;
+    simplify_ast(parse_string("0.0 * x - 0.0 * (0 - 1) * x"), simplified);
+    CHECK(intern_ast(simplified, dag) == 1);
+    CHECK(dag.nodes.size() == 6);
+
+    // the interned tree of a DAG is the same DAG
+    Ast src = parse_string("(x + 1) * (x + 1) + (x + 1) * (x + 1)");
+    Ast again;
+    intern_ast(src, dag);
+    CHECK(intern_ast(dag, again) == 0);
+    CHECK(again.nodes.size() == dag.nodes.size());
+    CHECK(again == src);
+}
+
+
+TEST_CASE("Test compile_ast on a DAG") {
+    Ast src = parse_string("(x * 2 + 1) * (x * 2 + 1) - (x * 2 + 1)");
+    Ast dag;
+    CHECK(intern_ast(src, dag) == 10);
+    Program prog = compile_ast(dag);
+    CHECK(repr_program(prog) ==
+        "LOAD 0\n"
+        "PUSH 0 ; 2\n"
+        "BINARY MULT\n"
+        "PUSH 1 ; 1\n"
+        "BINARY ADD\n"
+        "STORE 0\n"
+        "LOAD_TEMP 0\n"
+        "BINARY MULT\n"
+        "LOAD_TEMP 0\n"
+        "BINARY SUB\n"
+    );
+    CHECK(prog.temp_count == 1);
+    CHECK(prog.max_depth == 2);
+
+    VM vm;
+    for (int64_t x = -3; x <= 3; x++) {
+        Value var = Value::of_int(x);
+        CHECK(vm.run(prog, &var) == eval_ast(src, &var));
+    }
+}
+
+
+// expressions over few variables and constants, so that subtrees repeat
+static string random_expr(mt19937_64 &rng, int depth) {
+    if (depth == 0 || rng() % 4 == 0) {
+        const char *leaves[] = {"a", "b", "1", "2.5"};
+        return leaves[rng() % 4];
+    }
+    const char *ops[] = {" + ", " - ", " * ", " / "};
+    if (rng() % 8 == 0) {
+        return "(-" + random_expr(rng, depth - 1) + ")";
+    }
+    return "(" + random_expr(rng, depth - 1) + ops[rng() % 4] + random_expr(rng, depth - 1) + ")";
+}
+
+
+TEST_CASE("Test interned programs match eval_ast") {
+    mt19937_64 rng(21);
+    VM vm;
+    vector<Value> vars = {Value::of_int(7), Value::of_float(-0.5)};
+    size_t merged = 0;
+    for (int i = 0; i < 300; i++) {
+        string str = random_expr(rng, 6);
+        Ast src = parse_string(str);
+        Ast dag;
+        merged += intern_ast(src, dag);
+        string expected, got;
+        try {
+            expected = repr(eval_ast(src, vars.data()));
+        } catch (const BaseException &) {
+            expected = "error";
+        }
+        try {
+            got = repr(vm.run(compile_ast(dag), vars.data()));
+        } catch (const BaseException &) {
+            got = "error";
+        }
+        INFO(str);
+        CHECK(got == expected);
+    }
+    CHECK(merged > 0);
+}
+
+
+TEST_CASE("Test intern_ast deep") {
+    const size_t depth = 100000;
+    string str;
+    for (size_t i = 0; i < depth; i++) {
+        str += "(x + 1) * (";
+    }
+    Ast src = parse_string(str + "1" + string(depth, ')'));
+    Ast dag;
+    // every (x + 1) after the first, and each x and 1 in it
+    CHECK(intern_ast(src, dag) == 3 * depth - 2);
+    Value x = Value::of_int(0);
+    CHECK(VM().run(compile_ast(dag), &x) == Value::of_int(1));
+}
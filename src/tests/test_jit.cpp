@@ -0,0 +1,190 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+
+#include "../ast.h"
+#include "../eval_ast.h"
+#include "../exception.h"
+#include "../jit.h"
+#include "../parser.h"
+#include "../tokenizer.h"
+
+
+using std::memcmp;
+using std::mt19937_64;
+using std::string;
+using std::to_string;
+using std::vector;
+
+
+static Ast parse_string(const string &str) {
+    vector<Token::Ptr> tokens;
+    tokenize(str, tokens);
+    Parser parser;
+    for (const Token::Ptr &tok : tokens) {
+        parser.feed(tok);
+    }
+    return parser.get_result();
+}
+
+
+// same type and the same bits, so NaN results compare too
+static bool same_value(const Value &a, const Value &b) {
+    if (a.type == ValueType::BIG || b.type == ValueType::BIG) {
+        return a == b;
+    }
+    return a.type == b.type && memcmp(&a.ival, &b.ival, sizeof(a.ival)) == 0;
+}
+
+
+// a fully parenthesized expression with at most leaves operands
+static string random_expr(mt19937_64 &rng, int leaves) {
+    if (leaves <= 1) {
+        switch (rng() % 4) {
+        case 0: {
+            // sometimes large enough to overflow
+            string digits = to_string(int64_t(rng() % 41) - 20);
+            return "(" + digits + (rng() % 8 ? "" : "00000000000000000") + ")";
+        }
+        case 1:
+            return "(" + to_string(int64_t(rng() % 2001) - 1000) + ".25)";
+        default:
+            return string(1, "xyz"[rng() % 3]);
+        }
+    }
+    if (rng() % 5 == 0) {
+        return string("(") + "+-"[rng() % 2] + random_expr(rng, leaves - 1) + ")";
+    }
+    int left = 1 + int(rng() % (leaves - 1));
+    return "(" + random_expr(rng, left) + " " + "+-*/"[rng() % 4] + " "
+        + random_expr(rng, leaves - left) + ")";
+}
+
+
+TEST_CASE("Test jit matches eval_ast") {
+    mt19937_64 rng(15);
+    size_t native = 0;
+    size_t total = 0;
+
+    for (int i = 0; i < 3000; i++) {
+        string text = random_expr(rng, 1 + int(rng() % 8));
+        Ast ast = parse_string(text);
+        vector<ValueType> types(ast.var_names.size());
+        vector<Value> vars(ast.var_names.size());
+        for (size_t slot = 0; slot < vars.size(); slot++) {
+            bool is_int = rng() % 2;
+            types[slot] = is_int ? ValueType::INT : ValueType::FLOAT;
+            vars[slot] = is_int ? Value::of_int(int64_t(rng() % 21) - 10)
+                : Value::of_float((int64_t(rng() % 2001) - 1000) / 8.0);
+        }
+
+        JitExpr jit(ast, types);
+        Value expected = eval_ast(ast, vars.data());
+        INFO(text);
+        CHECK(same_value(jit.eval(vars.data()), expected));
+
+        Value result;
+        if (jit.function() && jit.function()(vars.data(), &result)) {
+            CHECK(same_value(result, expected));
+            native++;
+        }
+        total++;
+    }
+    // only int overflow and inexact or zero int divisions bail out
+    CHECK(native > total * 2 / 3);
+}
+
+
+TEST_CASE("Test jit values") {
+    JitExpr jit(parse_string("1 + 2 * 3"));
+    REQUIRE(jit.function());
+    Value result;
+    CHECK(jit.function()(nullptr, &result));
+    CHECK(result == Value::of_int(7));
+
+    CHECK(JitExpr(parse_string("-(2.5)")).eval() == Value::of_float(-2.5));
+    CHECK(JitExpr(parse_string("+3")).eval() == Value::of_int(3));
+    CHECK(JitExpr(parse_string("1 / 0")).eval() == Value::of_float(INFINITY));
+    CHECK(JitExpr(parse_string("1.5 / (2 - 2)")).eval() == Value::of_float(INFINITY));
+    CHECK(JitExpr(parse_string("7 / 2")).eval() == Value::of_float(3.5));
+    CHECK(JitExpr(parse_string("8 / (-2)")).eval() == Value::of_int(-4));
+}
+
+
+TEST_CASE("Test jit fallback") {
+    Ast ast = parse_string("a * 2 + b / a");
+    JitExpr jit(ast, {ValueType::INT, ValueType::FLOAT});
+    REQUIRE(jit.function());
+    Value result;
+
+    vector<Value> vars = {Value::of_int(4), Value::of_float(2.0)};
+    CHECK(jit.function()(vars.data(), &result));
+    CHECK(result == Value::of_float(8.5));
+
+    // variable of another type than compiled for
+    vars = {Value::of_float(0.5), Value::of_float(2.0)};
+    CHECK_FALSE(jit.function()(vars.data(), &result));
+    CHECK(jit.eval(vars.data()) == Value::of_float(5.0));
+
+    // inexact int division
+    JitExpr div(parse_string("a / b"), {ValueType::INT, ValueType::INT});
+    vars = {Value::of_int(6), Value::of_int(3)};
+    CHECK(div.eval(vars.data()) == Value::of_int(2));
+    CHECK(div.function()(vars.data(), &result));
+    vars = {Value::of_int(7), Value::of_int(2)};
+    CHECK_FALSE(div.function()(vars.data(), &result));
+    CHECK(div.eval(vars.data()) == Value::of_float(3.5));
+
+    // int overflow
+    JitExpr add(parse_string("a + 1"), {ValueType::INT});
+    vars = {Value::of_int(INT64_MAX - 1)};
+    CHECK(add.eval(vars.data()) == Value::of_int(INT64_MAX));
+    vars = {Value::of_int(INT64_MAX)};
+    CHECK_FALSE(add.function()(vars.data(), &result));
+    CHECK(add.eval(vars.data()) == Value::of_big(BigInt::from_digits("9223372036854775808")));
+
+    JitExpr neg(parse_string("-a / (-1) * a"), {ValueType::INT});
+    vars = {Value::of_int(-3037000499)};
+    CHECK(neg.eval(vars.data()) == Value::of_int(9223372030926249001));
+    vars = {Value::of_int(INT64_MIN)};
+    CHECK_FALSE(neg.function()(vars.data(), &result));
+
+    JitExpr minus_one(parse_string("a / (-1)"), {ValueType::INT});
+    vars = {Value::of_int(INT64_MIN + 1)};
+    CHECK(minus_one.eval(vars.data()) == Value::of_int(INT64_MAX));
+    vars = {Value::of_int(INT64_MIN)};
+    CHECK_FALSE(minus_one.function()(vars.data(), &result));
+    CHECK(minus_one.eval(vars.data()) == Value::of_big(BigInt::from_digits("9223372036854775808")));
+
+    // BIG values are not compiled
+    JitExpr big(parse_string("a + 9223372036854775808"), {ValueType::INT});
+    CHECK_FALSE(big.function());
+    vars = {Value::of_int(-1)};
+    CHECK(big.eval(vars.data()) == Value::of_int(INT64_MAX));
+    JitExpr big_var(parse_string("a + 1"), {ValueType::BIG});
+    CHECK_FALSE(big_var.function());
+
+    // more nested ints than registers
+    JitExpr deep(parse_string("1 - (2 - (3 - (4 - (5 - (6 - (7 - 8))))))"));
+    CHECK_FALSE(deep.function());
+    CHECK(deep.eval() == Value::of_int(-4));
+
+    CHECK_THROWS_AS(JitExpr(ast, {ValueType::INT}), const ArgumentError &);
+    CHECK_THROWS_AS(JitExpr(parse_string("x")).eval(), const EvalError &);
+}
+
+
+TEST_CASE("Test jit large ast") {
+    string str = "a";
+    for (size_t i = 0; i < JitExpr::MAX_NODES; i++) {
+        str += " + 1";
+    }
+    JitExpr jit(parse_string(str), {ValueType::INT});
+    CHECK_FALSE(jit.function());
+    Value a = Value::of_int(1);
+    CHECK(jit.eval(&a) == Value::of_int(JitExpr::MAX_NODES + 1));
+}
@@ -0,0 +1,139 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+
+#include "../number.h"
+#include "../tokens.h"
+
+
+using std::mt19937_64;
+using std::numeric_limits;
+using std::string;
+using std::strtod;
+using std::vector;
+
+
+static bool same_as_strtod(const string &text) {
+    Token::Ptr tok = make_number(text);
+    double expected = strtod(text.data(), nullptr);
+    if (tok->type == TokenType::INT) {
+        return static_cast<TokenInt &>(*tok).value == expected;
+    } else {
+        // compare the bits, so that zeros and infinities are checked as well
+        double value = static_cast<TokenFloat &>(*tok).value;
+        return memcmp(&value, &expected, sizeof(double)) == 0;
+    }
+}
+
+
+// collects the mismatching literals, so that a large number of inputs stays cheap to check
+struct StrtodChecker {
+    vector<string> mismatches;
+
+    void operator()(const string &text) {
+        if (!same_as_strtod(text)) {
+            this->mismatches.push_back(text);
+        }
+    }
+};
+
+
+TEST_CASE("Test make_number int") {
+    CHECK(*make_number("0") == TokenInt(0));
+    CHECK(*make_number("123") == TokenInt(123));
+    CHECK(*make_number("12e3") == TokenInt(12000));
+    CHECK(*make_number("0e999999999999") == TokenInt(0));
+    CHECK(*make_number("9223372036854775807") == TokenInt(numeric_limits<int64_t>::max()));
+    CHECK(*make_number("9223372036854775808") == TokenBig(BigInt::from_digits("9223372036854775808")));
+    CHECK(*make_number("1e19") == TokenFloat(1e19));
+    CHECK(*make_number("1e-0") == TokenFloat(1.0));
+    CHECK(*make_number("1.") == TokenFloat(1.0));
+}
+
+
+TEST_CASE("Test make_number float") {
+    CHECK(*make_number("0.1") == TokenFloat(0.1));
+    CHECK(*make_number(".5") == TokenFloat(0.5));
+    CHECK(*make_number("1e400") == TokenFloat(numeric_limits<double>::infinity()));
+    CHECK(*make_number("1e-400") == TokenFloat(0.0));
+    CHECK(*make_number("0.0001e-320") == TokenFloat(0.0));
+    CHECK(*make_number("100000e-329") == TokenFloat(0.0));
+    CHECK(*make_number("4.9e-324") == TokenFloat(numeric_limits<double>::denorm_min()));
+
+    // the naive digit summing gets these wrong
+    CHECK(same_as_strtod("0.1234567890123456789012345678901234567890"));
+    CHECK(same_as_strtod("9007199254740993.0"));
+    CHECK(same_as_strtod("2.2250738585072011e-308"));
+    CHECK(same_as_strtod("1.7976931348623157e308"));
+    CHECK(same_as_strtod("1.7976931348623159e308"));
+}
+
+
+TEST_CASE("Test make_number powers of ten") {
+    StrtodChecker check;
+    for (int exp = -350; exp <= 350; exp++) {
+        for (const char *mantissa : {"1", "9.999999999999999", "0.5", "4.9406564584124654"}) {
+            check(string(mantissa) + "e" + std::to_string(exp));
+        }
+    }
+    CHECK(check.mismatches == vector<string>());
+}
+
+
+TEST_CASE("Test make_number round trip") {
+    mt19937_64 rng(20161017);
+    StrtodChecker check;
+    vector<double> not_round_trip;
+    char buf[64];
+    for (int i = 0; i < 200000; i++) {
+        uint64_t bits = rng();
+        double value;
+        memcpy(&value, &bits, sizeof(double));
+        value = std::fabs(value);
+        if (!std::isfinite(value)) {
+            continue;
+        }
+
+        for (int precision : {17, 15, 6}) {
+            snprintf(buf, sizeof(buf), "%.*g", precision, value);
+            check(buf);
+        }
+        snprintf(buf, sizeof(buf), "%.17g", value);
+        Token::Ptr tok = make_number(buf);
+        if (tok->type == TokenType::FLOAT && static_cast<TokenFloat &>(*tok).value != value) {
+            not_round_trip.push_back(value);
+        }
+    }
+    CHECK(check.mismatches == vector<string>());
+    CHECK(not_round_trip == vector<double>());
+}
+
+
+TEST_CASE("Test make_number long digits") {
+    mt19937_64 rng(42);
+    StrtodChecker check;
+    for (int i = 0; i < 20000; i++) {
+        string text;
+        size_t int_len = rng() % 30;
+        size_t frac_len = rng() % 60 + 1;
+        for (size_t k = 0; k < int_len; k++) {
+            text.push_back('0' + rng() % 10);
+        }
+        text.push_back('.');
+        for (size_t k = 0; k < frac_len; k++) {
+            text.push_back('0' + rng() % 10);
+        }
+        if (rng() % 2) {
+            text += "e" + std::to_string(static_cast<int>(rng() % 700) - 350);
+        }
+        check(text);
+    }
+    CHECK(check.mismatches == vector<string>());
+}
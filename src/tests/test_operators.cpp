@@ -1,30 +1,111 @@
-#include <memory>
+#include <cstdint>
+#include <limits>
 #include "catch.hpp"
 
 #include "../operators.h"
+#include "../value.h"
 
 
-using std::make_shared;
+Value T(int value) {
+    return Value::of_int(value);
+}
 
 
-Token::Ptr T(int value) {
-    return make_shared<TokenInt>(value);
+Value T(double value) {
+    return Value::of_float(value);
 }
 
 
-Token::Ptr T(double value) {
-    return make_shared<TokenFloat>(value);
+// a decimal that may not fit int64, with an optional minus sign
+Value B(const char *text) {
+    if (text[0] == '-') {
+        return Value::of_big(-BigInt::from_digits(text + 1));
+    }
+    return Value::of_big(BigInt::from_digits(text));
 }
 
 
 TEST_CASE("Test operator_add") {
-    CHECK(*op_add({T(1), T(2)}) == *T(3));
-    CHECK(*op_add({T(1), T(2.0)}) == *T(3.0));
+    CHECK(apply_binary(OpCode::ADD, T(1), T(2)) == T(3));
+    CHECK(apply_binary(OpCode::ADD, T(1), T(2.0)) == T(3.0));
+    CHECK(apply_binary(OpCode::ADD, T(1.0), T(2)) == T(3.0));
+    CHECK(apply_unary(OpCode::POS, T(1)) == T(1));
+}
+
+
+TEST_CASE("Test operator_sub") {
+    CHECK(apply_binary(OpCode::SUB, T(1), T(2)) == T(-1));
+    CHECK(apply_binary(OpCode::SUB, T(1.5), T(2.5)) == T(-1.0));
+    CHECK(apply_unary(OpCode::NEG, T(1)) == T(-1));
+    CHECK(apply_unary(OpCode::NEG, T(1.5)) == T(-1.5));
 }
 
 
 TEST_CASE("Test operator_div") {
-    CHECK(*op_div({T(3), T(2)}) == *T(1.5));
-    CHECK(*op_div({T(4), T(2)}) == *T(2));
-    CHECK(*op_div({T(2), T(0)}) == *T(std::numeric_limits<double>::infinity()));
+    CHECK(apply_binary(OpCode::DIV, T(3), T(2)) == T(1.5));
+    CHECK(apply_binary(OpCode::DIV, T(4), T(2)) == T(2));
+    CHECK(apply_binary(OpCode::DIV, T(2), T(0)) == T(std::numeric_limits<double>::infinity()));
+    CHECK(apply_binary(OpCode::DIV, T(2.0), T(0)) == T(std::numeric_limits<double>::infinity()));
+}
+
+
+TEST_CASE("Test int overflow") {
+    const int64_t max = std::numeric_limits<int64_t>::max();
+    const int64_t min = std::numeric_limits<int64_t>::min();
+    auto I = Value::of_int;
+
+    // exact above 2^53
+    CHECK(apply_binary(OpCode::ADD, I(9007199254740992), T(1)) == I(9007199254740993));
+    CHECK(apply_binary(OpCode::MULT, I(3037000499), I(3037000499)) == I(9223372030926249001));
+    CHECK(apply_binary(OpCode::DIV, I(max), I(max)) == T(1));
+    CHECK(apply_binary(OpCode::DIV, I(max), T(-1)) == I(-max));
+
+    // promoted to BIG on overflow
+    CHECK(apply_binary(OpCode::ADD, I(max), T(1)) == B("9223372036854775808"));
+    CHECK(apply_binary(OpCode::SUB, I(min), T(1)) == B("-9223372036854775809"));
+    CHECK(apply_binary(OpCode::MULT, I(3037000500), I(3037000500)) == B("9223372037000250000"));
+    CHECK(apply_binary(OpCode::DIV, I(min), T(-1)) == B("9223372036854775808"));
+    CHECK(apply_unary(OpCode::NEG, I(min)) == B("9223372036854775808"));
+    CHECK(apply_unary(OpCode::POS, I(min)) == I(min));
+}
+
+
+TEST_CASE("Test operator big") {
+    auto I = Value::of_int;
+    Value big = B("100000000000000000000");
+
+    CHECK(apply_binary(OpCode::ADD, big, I(1)) == B("100000000000000000001"));
+    CHECK(apply_binary(OpCode::SUB, I(1), big) == B("-99999999999999999999"));
+    CHECK(apply_binary(OpCode::MULT, big, big) == B("10000000000000000000000000000000000000000"));
+    CHECK(apply_unary(OpCode::NEG, apply_unary(OpCode::NEG, big)) == big);
+    CHECK(apply_unary(OpCode::POS, big) == big);
+
+    // back to INT when the result fits
+    CHECK(apply_binary(OpCode::SUB, big, big) == I(0));
+    CHECK(apply_binary(OpCode::DIV, big, B("50000000000000000000")) == I(2));
+    CHECK(apply_binary(OpCode::SUB, big, I(1)).type == ValueType::BIG);
+
+    // with floats, or an inexact division, the result is a float
+    CHECK(apply_binary(OpCode::ADD, big, T(0.5)) == T(1e20));
+    CHECK(apply_binary(OpCode::DIV, T(1e20), big) == T(1.0));
+    CHECK(apply_binary(OpCode::DIV, big, I(3)) == T(1e20 / 3));
+    CHECK(apply_binary(OpCode::DIV, big, I(0)) == T(std::numeric_limits<double>::infinity()));
+    CHECK(apply_binary(OpCode::DIV, big, T(0.0)) == T(std::numeric_limits<double>::infinity()));
+}
+
+
+TEST_CASE("Test operator registry") {
+    for (size_t i = 0; i < OPCODE_COUNT; i++) {
+        OpCode op = static_cast<OpCode>(i);
+        const OpInfo &info = op_info(op);
+        CHECK(token_opcode(info.token, info.arity) == op);
+        for (size_t k = 0; k < 3; k++) {
+            CHECK((g_unary_kernels[i][k] != nullptr) == (info.arity == 1));
+        }
+        for (size_t k = 0; k < 9; k++) {
+            CHECK((g_binary_kernels[i][k] != nullptr) == (info.arity == 2));
+        }
+    }
+    CHECK(token_opcode(TokenType::MULT, 1) == OpCode::COUNT);
+    CHECK(token_opcode(TokenType::LPAR, 2) == OpCode::COUNT);
 }
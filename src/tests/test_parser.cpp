@@ -2,6 +2,7 @@
 #include <string>
 #include "catch.hpp"
 
+#include "../ast.h"
 #include "../node.h"
 #include "../parser.h"
 #include "../tokenizer.h"
@@ -23,7 +24,7 @@ Node::Ptr parse(const string &str) {
         parser.feed(tok);
     }
 
-    return parser.get_result();
+    return ast_to_node(parser.get_result());
 }
 
 
@@ -122,12 +123,107 @@ TEST_CASE("Test parser") {
 
 
 TEST_CASE("Test parser bad input") {
-    CHECK_THROWS_AS(parse(""), ParserError);
-    CHECK_THROWS_AS(parse("+"), ParserError);
-    CHECK_THROWS_AS(parse("1+"), ParserError);
-    CHECK_THROWS_AS(parse("()"), ParserError);
-    CHECK_THROWS_AS(parse("(1)+"), ParserError);
-    CHECK_THROWS_AS(parse("1 2"), ParserError);
-    CHECK_THROWS_AS(parse("*1"), ParserError);
-    CHECK_THROWS_AS(parse("(1"), ParserError);
+    CHECK_THROWS_AS(parse(""), const ParserError &);
+    CHECK_THROWS_AS(parse("+"), const ParserError &);
+    CHECK_THROWS_AS(parse("1+"), const ParserError &);
+    CHECK_THROWS_AS(parse("()"), const ParserError &);
+    CHECK_THROWS_AS(parse("(1)+"), const ParserError &);
+    CHECK_THROWS_AS(parse("1 2"), const ParserError &);
+    CHECK_THROWS_AS(parse("*1"), const ParserError &);
+    CHECK_THROWS_AS(parse("(1"), const ParserError &);
+}
+
+
+static const Ast &parse_into(Parser &parser, const string &str) {
+    Tokenizer tokenizer;
+    Token::Ptr tok;
+    for (size_t i = 0; i <= str.size(); i++) {
+        tokenizer.feed(str[i]);
+    }
+    while ((tok = tokenizer.pop())) {
+        parser.feed(tok);
+    }
+    return parser.get_result();
+}
+
+
+TEST_CASE("Test parser arena") {
+    Parser parser;
+    const Ast &ast = parse_into(parser, "-(1 + 2.5) * 3");
+    CHECK(ast.nodes.size() == 6);
+    CHECK(repr_ast(ast, ast.root) == repr_node(*parse("-(1 + 2.5) * 3")));
+    CHECK(repr(ast) ==
+        "Token:- \n"
+        "    Token:* \n"
+        "        Token:+ \n"
+        "            Int 1\n"
+        "            Float 2.500000\n"
+        "        Int 3\n"
+    );
+
+    const AstNode &root = ast[ast.root];
+    CHECK(root.op == OpCode::NEG);
+    CHECK(root.nchildren == 1);
+    CHECK(ast[root.children[0]].op == OpCode::MULT);
+
+    const AstNode *data = ast.nodes.data();
+    parser.reset();
+    CHECK(ast.empty());
+    parse_into(parser, "4 / 2");
+    CHECK(ast.nodes.size() == 3);
+    CHECK(ast.nodes.data() == data);
+
+    Parser other;
+    CHECK(parse_into(other, "(4) / (2)") == ast);
+    other.reset();
+    CHECK(parse_into(other, "4 / 2.0") != ast);
+}
+
+
+TEST_CASE("Test parser post-order") {
+    Parser parser;
+    const Ast &ast = parse_into(parser, "-(1 + 2) * 3 / (4 - (-5)) + 6");
+    CHECK(ast.root == ast.nodes.size() - 1);
+    for (NodeId id = 0; id < ast.nodes.size(); id++) {
+        for (size_t i = 0; i < ast[id].nchildren; i++) {
+            CHECK(ast[id].children[i] < id);
+        }
+    }
+}
+
+
+TEST_CASE("Test parser deep trees") {
+    const size_t depth = 100000;
+    string str;
+    for (size_t i = 0; i < depth; i++) {
+        str += "1 - (";
+    }
+    str += "x" + string(depth, ')');
+
+    Parser parser, other;
+    const Ast &ast = parse_into(parser, str);
+    CHECK(ast.nodes.size() == 2 * depth + 1);
+    // compared outside CHECK(), which would print the trees
+    const Ast &other_ast = parse_into(other, str);
+    bool same = other_ast == ast;
+    CHECK(same);
+
+    Node::Ptr node = ast_to_node(ast);
+    Node::Ptr copy = ast_to_node(other_ast);
+    same = *node == *copy;
+    CHECK(same);
+    copy->children[1]->children[1]->children[0]->token = make_shared<TokenInt>(2);
+    same = *node == *copy;
+    CHECK_FALSE(same);
+    // the chains are freed without recursion
+    node.reset();
+    copy.reset();
+
+    str = "1";
+    for (size_t i = 0; i < 2000; i++) {
+        str = "-(" + str + ")";
+    }
+    parser.reset();
+    parse_into(parser, str);
+    CHECK(repr_ast(ast, ast.root) == repr_node(*ast_to_node(ast)));
 }
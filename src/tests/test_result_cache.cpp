@@ -0,0 +1,104 @@
+#include <string>
+#include <vector>
+#include "catch.hpp"
+
+#include "../result_cache.h"
+#include "../tokenizer.h"
+
+
+using std::string;
+using std::vector;
+
+
+static string key_of(const string &line) {
+    vector<Token::Ptr> tokens;
+    tokenize(line, tokens);
+    string key;
+    ResultCache::token_key(tokens, key);
+    return key;
+}
+
+
+TEST_CASE("Test ResultCache keys") {
+    CHECK(key_of("1 + 2") == key_of("1+2"));
+    CHECK(key_of("(a * 2.5)") == key_of(" ( a*2.5 ) "));
+    CHECK(key_of("1e2") == key_of("100"));
+    CHECK(key_of("99999999999999999999 - x") == key_of("99999999999999999999-x"));
+
+    CHECK(key_of("1 + 2") != key_of("1 + 3"));
+    CHECK(key_of("1 + 2") != key_of("1 + 2.0"));
+    CHECK(key_of("1 - 2") != key_of("1 + 2"));
+    CHECK(key_of("12") != key_of("1 2"));
+    CHECK(key_of("ab") != key_of("a b"));
+    CHECK(key_of("ab + c") != key_of("a + bc"));
+
+    string line;
+    ResultCache::line_key("1 + 2", line);
+    CHECK(line != key_of("1 + 2"));
+    CHECK(line.substr(1) == "1 + 2");
+}
+
+
+TEST_CASE("Test ResultCache lookup") {
+    ResultCache cache(4);
+    Value value;
+    CHECK_FALSE(cache.lookup("a", value));
+    cache.insert("a", Value::of_int(1));
+    cache.insert("b", Value::of_float(2.5));
+    CHECK(cache.lookup("a", value));
+    CHECK(value == Value::of_int(1));
+    CHECK(cache.lookup("b", value));
+    CHECK(value == Value::of_float(2.5));
+
+    cache.insert("a", Value::of_int(3));
+    CHECK(cache.lookup("a", value));
+    CHECK(value == Value::of_int(3));
+    CHECK(cache.size() == 2);
+    CHECK(cache.hits() == 3);
+    CHECK(cache.misses() == 1);
+    CHECK_FALSE(cache.lookup("c", value, false));
+    CHECK(cache.misses() == 1);
+
+    cache.clear();
+    CHECK(cache.size() == 0);
+    CHECK(cache.hits() == 0);
+    CHECK_FALSE(cache.lookup("a", value));
+
+    ResultCache disabled;
+    disabled.insert("a", Value::of_int(1));
+    CHECK_FALSE(disabled.lookup("a", value));
+    CHECK(disabled.size() == 0);
+}
+
+
+TEST_CASE("Test ResultCache eviction") {
+    ResultCache cache(3);
+    Value value;
+    cache.insert("a", Value::of_int(1));
+    cache.insert("b", Value::of_int(2));
+    cache.insert("c", Value::of_int(3));
+    CHECK(cache.lookup("a", value));
+    CHECK(cache.lookup("c", value));
+
+    // b is the only entry without a hit
+    cache.insert("d", Value::of_int(4));
+    CHECK(cache.size() == 3);
+    CHECK_FALSE(cache.lookup("b", value));
+    CHECK(cache.lookup("a", value));
+    CHECK(cache.lookup("c", value));
+    CHECK(cache.lookup("d", value));
+    CHECK(value == Value::of_int(4));
+
+    // every entry was hit, the hand clears them all and takes the next one
+    cache.insert("e", Value::of_int(5));
+    CHECK_FALSE(cache.lookup("c", value));
+    CHECK(cache.lookup("e", value));
+
+    // many keys through a small cache
+    for (int i = 0; i < 1000; i++) {
+        cache.insert(std::to_string(i), Value::of_int(i));
+        CHECK(cache.lookup(std::to_string(i), value));
+        CHECK(value == Value::of_int(i));
+    }
+    CHECK(cache.size() == 3);
+}
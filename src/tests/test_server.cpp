@@ -0,0 +1,195 @@
+#include <arpa/inet.h>
+#include <cstring>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "catch.hpp"
+
+#include "../exception.h"
+#include "../server.h"
+
+
+using std::memcpy;
+using std::string;
+using std::thread;
+using std::to_string;
+using std::vector;
+
+
+static string socket_path() {
+    return "/tmp/calcxx_test_" + to_string(getpid()) + ".sock";
+}
+
+
+static int connect_unix(const string &path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.data(), path.size());
+    REQUIRE(connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+    return fd;
+}
+
+
+static int connect_tcp(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(uint16_t(port));
+    REQUIRE(connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+    return fd;
+}
+
+
+static void send_all(int fd, const string &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        REQUIRE(n > 0);
+        sent += size_t(n);
+    }
+}
+
+
+// reads until the server closes the connection
+static string read_all(int fd) {
+    string ans;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        ans.append(buf, size_t(n));
+    }
+    return ans;
+}
+
+
+// reads one response line, without its newline
+static string read_line(int fd) {
+    string ans;
+    char c;
+    while (read(fd, &c, 1) == 1 && c != '\n') {
+        ans += c;
+    }
+    return ans;
+}
+
+
+TEST_CASE("Test Server unix socket") {
+    ServerOptions options;
+    options.unix_path = socket_path();
+    options.threads = 2;
+    Server server(options);
+    CHECK(server.tcp_port() == -1);
+    thread loop([&]() {
+        server.run();
+    });
+
+    // lines split over several writes, a last line without newline
+    int fd = connect_unix(options.unix_path);
+    send_all(fd, "1 + 2\n\n1 +\n2 * (3");
+    send_all(fd, " + x)\n7 / 2");
+    shutdown(fd, SHUT_WR);
+    CHECK(read_all(fd) ==
+        "3\n"
+        "\n"
+        "error: col 4: ParserError: expected token types: expect '(ifn' got Token:$: \n"
+        "error: col 10: EvalError: unbound variable: x\n"
+        "3.500000\n"
+    );
+    close(fd);
+
+    // concurrent clients each get their own answers
+    vector<int> clients;
+    for (int i = 0; i < 20; i++) {
+        clients.push_back(connect_unix(options.unix_path));
+        send_all(clients.back(), to_string(i) + " * 2\n");
+    }
+    for (int i = 0; i < 20; i++) {
+        CHECK(read_line(clients[i]) == to_string(i * 2));
+        send_all(clients[i], "1 / 4\n");
+    }
+    for (int fd : clients) {
+        CHECK(read_line(fd) == "0.250000");
+        close(fd);
+    }
+
+    server.stop();
+    loop.join();
+}
+
+
+TEST_CASE("Test Server tcp pipelining") {
+    ServerOptions options;
+    options.tcp_port = 0;
+    options.mode = EvalMode::bytecode;
+    options.cache_size = 16;
+    Server server(options);
+    REQUIRE(server.tcp_port() > 0);
+    thread loop([&]() {
+        server.run();
+    });
+
+    // more requests than the socket buffers hold, sent without waiting
+    const int count = 100000;
+    string requests, expected;
+    for (int i = 0; i < count; i++) {
+        requests += to_string(i % 100) + " + 1\n";
+        expected += to_string(i % 100 + 1) + "\n";
+    }
+    int fd = connect_tcp(server.tcp_port());
+    thread writer([&]() {
+        send_all(fd, requests);
+        shutdown(fd, SHUT_WR);
+    });
+    string responses = read_all(fd);
+    writer.join();
+    close(fd);
+    CHECK(responses.size() == expected.size());
+    CHECK(responses == expected);
+
+    server.stop();
+    loop.join();
+}
+
+
+TEST_CASE("Test Server errors") {
+    ServerOptions options;
+    options.unix_path = "/tmp/" + string(200, 'x');
+    CHECK_THROWS_AS(Server{options}, const IOError &);
+    options.unix_path = "/nonexistent/dir/calcxx.sock";
+    CHECK_THROWS_AS(Server{options}, const IOError &);
+
+    options.unix_path = socket_path();
+    {
+        Server server(options);
+        CHECK_THROWS_AS(Server{options}, const IOError &);
+        thread loop([&]() {
+            server.run();
+        });
+
+        // too long a line closes the connection
+        int fd = connect_unix(options.unix_path);
+        thread writer([&]() {
+            string chunk(1 << 16, '1');
+            for (size_t sent = 0; sent <= Server::MAX_LINE; sent += chunk.size()) {
+                if (send(fd, chunk.data(), chunk.size(), MSG_NOSIGNAL) < 0) {
+                    break;
+                }
+            }
+        });
+        CHECK(read_all(fd) == "");
+        writer.join();
+        close(fd);
+
+        server.stop();
+        loop.join();
+    }
+    struct stat st;
+    CHECK(stat(options.unix_path.c_str(), &st) != 0);
+}
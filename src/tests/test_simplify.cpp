@@ -0,0 +1,152 @@
+#include <cmath>
+#include <string>
+#include "catch.hpp"
+
+#include "../ast.h"
+#include "../calculator.h"
+#include "../eval_ast.h"
+#include "../exception.h"
+#include "../parser.h"
+#include "../simplify.h"
+#include "../tokenizer.h"
+
+
+using std::signbit;
+using std::string;
+
+
+static Ast parse_string(const string &str) {
+    vector<Token::Ptr> tokens;
+    tokenize(str, tokens);
+    Parser parser;
+    for (const Token::Ptr &tok : tokens) {
+        parser.feed(tok);
+    }
+    return parser.get_result();
+}
+
+
+static Ast simplify_string(const string &str) {
+    Ast ans;
+    simplify_ast(parse_string(str), ans);
+    return ans;
+}
+
+
+TEST_CASE("Test simplify constant folding") {
+    for (string str : {
+        "1", "(3 * 4 + 2) * 5", "1 + 0", "2.5 * 1", "-(1)", "+4 / (2 - 2)",
+        "7 / 2", "6 / 3 * 1.0", "1 - 2 + 3 * 4 / 5", "((((0.5))))",
+    }) {
+        Ast ast = simplify_string(str);
+        CHECK(ast.nodes.size() == 1);
+        CHECK(eval_ast(ast) == eval_ast(parse_string(str)));
+    }
+
+    CHECK(repr(simplify_string("(3 * 4 + 2) * 5")) == "Int 70\n");
+    CHECK(repr(simplify_string("3 / 2")) == "Float 1.500000\n");
+}
+
+
+TEST_CASE("Test simplify keeps signed zero") {
+    Ast ast = simplify_string("0.0 * (0 - 1) - 0");
+    REQUIRE(ast.nodes.size() == 1);
+    CHECK(signbit(eval_ast(ast).fval));
+    CHECK(signbit(eval_ast(parse_string("0.0 * (0 - 1) - 0")).fval));
+}
+
+
+TEST_CASE("Test simplify reuses dst") {
+    Ast ast;
+    simplify_ast(parse_string("1 + 2 + 3 + 4"), ast);
+    const AstNode *data = ast.nodes.data();
+    simplify_ast(parse_string("5 * 6"), ast);
+    CHECK(ast.nodes.data() == data);
+    CHECK(eval_ast(ast) == Value::of_int(30));
+
+    simplify_ast(Ast(), ast);
+    CHECK(ast.empty());
+}
+
+
+TEST_CASE("Test simplify bad operator") {
+    Ast ast;
+    NodeId node = ast.add_operator(TokenType::MULT);
+    ast.add_child(node, ast.add_value(Value::of_int(1)));
+    ast.root = node;
+
+    Ast out;
+    CHECK_THROWS_AS(simplify_ast(ast, out), const ArgumentError &);
+}
+
+
+TEST_CASE("Test Calculator dump_line") {
+    Calculator calc;
+    string text;
+    LineResult result = calc.dump_line("-(1 + 2) * 3", text);
+    CHECK(result.status == LineStatus::ok);
+    CHECK(result.value == Value::of_int(-9));
+    CHECK(text ==
+        "ast:\n"
+        "Token:- \n"
+        "    Token:* \n"
+        "        Token:+ \n"
+        "            Int 1\n"
+        "            Int 2\n"
+        "        Int 3\n"
+        "simplified:\n"
+        "Int -9\n"
+    );
+
+    result = calc.dump_line("1 +", text);
+    CHECK(result.status == LineStatus::error);
+    CHECK(text.empty());
+}
+
+
+TEST_CASE("Test simplify identities") {
+    // a float subtree keeps its value through * 1, / 1 and - 0
+    CHECK(repr(simplify_string("x * 2.0 * 1 / 1 - 0")) ==
+        "Token:* \n"
+        "    Name x\n"
+        "    Float 2.000000\n"
+    );
+    CHECK(repr(simplify_string("1 * (x * 2.0)")) == repr(simplify_string("x * 2.0")));
+
+    // x + 0 turns -0.0 into 0.0
+    CHECK(simplify_string("x * 2.0 + 0").nodes.size() == 5);
+    // int arithmetic is exact, an int constant keeps x whatever its type
+    CHECK(repr(simplify_string("1 * x / 1 - 0")) == "Name x\n");
+    // the type of x is unknown, 1.0 may turn it into a float
+    CHECK(simplify_string("x * 1.0").nodes.size() == 3);
+    CHECK(simplify_string("x + 0").nodes.size() == 3);
+    // 1.0 would turn an int into a float
+    CHECK(simplify_string("x * 2 * 1.0").nodes.size() == 5);
+
+    Ast ast = simplify_string("(3 * 4 + 2) * x");
+    CHECK(repr(ast) == "Token:* \n    Int 14\n    Name x\n");
+    CHECK(ast.var_names == vector<string>({"x"}));
+}
+
+
+TEST_CASE("Test simplify deep") {
+    const size_t depth = 100000;
+    string str = "x";
+    for (size_t i = 0; i < depth; i++) {
+        str += " * 1 - 0";
+    }
+    CHECK(repr(simplify_string(str)) == "Name x\n");
+
+    str.clear();
+    for (size_t i = 0; i < depth; i++) {
+        str += "2 - (";
+    }
+    Ast ast = simplify_string(str + "1 + 1" + string(depth, ')'));
+    CHECK(ast.nodes.size() == 1);
+    CHECK(eval_ast(ast) == Value::of_int(2));
+
+    ast = simplify_string(str + "x" + string(depth, ')'));
+    CHECK(ast.nodes.size() == 2 * depth + 1);
+    Value x = Value::of_int(5);
+    CHECK(eval_ast(ast, &x) == Value::of_int(5));
+}
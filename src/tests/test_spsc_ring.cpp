@@ -0,0 +1,62 @@
+#include <string>
+#include <thread>
+#include "catch.hpp"
+
+#include "../spsc_ring.h"
+
+
+using std::string;
+using std::thread;
+using std::to_string;
+
+
+TEST_CASE("Test SpscRing") {
+    SpscRing<string> ring(3);
+    CHECK(ring.capacity() == 4);
+
+    string item;
+    CHECK(!ring.try_pop(item));
+    for (int i = 0; i < 4; i++) {
+        string str = to_string(i);
+        CHECK(ring.try_push(str));
+        CHECK(str.empty());
+    }
+    string rejected = "4";
+    CHECK(!ring.try_push(rejected));
+    CHECK(rejected == "4");
+
+    // wraps around
+    for (int i = 4; i < 10; i++) {
+        CHECK(ring.try_pop(item));
+        CHECK(item == to_string(i - 4));
+        ring.push(to_string(i));
+    }
+    ring.close();
+    for (int i = 6; i < 10; i++) {
+        CHECK(ring.pop(item));
+        CHECK(item == to_string(i));
+    }
+    CHECK(!ring.pop(item));
+}
+
+
+TEST_CASE("Test SpscRing threads") {
+    const size_t count = 200000;
+    SpscRing<size_t> ring(16);
+    thread producer([&]() {
+        for (size_t i = 0; i < count; i++) {
+            ring.push(i);
+        }
+        ring.close();
+    });
+
+    size_t item, expected = 0;
+    bool in_order = true;
+    while (ring.pop(item)) {
+        in_order = in_order && item == expected;
+        expected++;
+    }
+    producer.join();
+    CHECK(in_order);
+    CHECK(expected == count);
+}
@@ -0,0 +1,111 @@
+#include <cstdint>
+#include <thread>
+#include "catch.hpp"
+
+#include "../calculator.h"
+#include "../stats.h"
+
+
+using std::thread;
+
+
+TEST_CASE("Test LatencyHistogram buckets") {
+    CHECK(LatencyHistogram::bucket_of(0) == 0);
+    CHECK(LatencyHistogram::bucket_of(31) == 31);
+    CHECK(LatencyHistogram::bucket_of(32) == 32);
+    CHECK(LatencyHistogram::bucket_of(63) == 63);
+    CHECK(LatencyHistogram::bucket_of(64) == 64);
+    CHECK(LatencyHistogram::bucket_of(65) == 64);
+    CHECK(LatencyHistogram::bucket_of(uint64_t(1) << 50) == LatencyHistogram::BUCKET_COUNT - 1);
+
+    // buckets are contiguous and start where bucket_of() puts their first value
+    bool contiguous = true;
+    for (size_t i = 1; i < LatencyHistogram::BUCKET_COUNT; i++) {
+        uint64_t start = LatencyHistogram::bucket_start(i);
+        contiguous = contiguous
+            && LatencyHistogram::bucket_of(start) == i
+            && LatencyHistogram::bucket_of(start - 1) == i - 1;
+    }
+    CHECK(contiguous);
+}
+
+
+TEST_CASE("Test LatencyHistogram percentiles") {
+    LatencyHistogram hist;
+    CHECK(hist.percentile(50) == 0);
+    for (uint64_t ns = 1; ns <= 10000; ns++) {
+        hist.record(ns * 100);
+    }
+    CHECK(hist.count() == 10000);
+    CHECK(hist.max() == 1000000);
+    CHECK(hist.mean() == Approx(500050));
+    // within the about 3% of a bucket, never below the exact value
+    for (double p : {1.0, 50.0, 90.0, 99.0, 99.9}) {
+        double exact = p * 10000;
+        CHECK(hist.percentile(p) >= exact);
+        CHECK(hist.percentile(p) <= exact * 1.04);
+    }
+    CHECK(hist.percentile(100) == 1000000);
+
+    LatencyHistogram other;
+    other.record(5000000);
+    hist.merge(other);
+    CHECK(hist.count() == 10001);
+    CHECK(hist.max() == 5000000);
+    hist.clear();
+    CHECK(hist.count() == 0);
+    CHECK(hist.max() == 0);
+}
+
+
+TEST_CASE("Test runtime stats") {
+    reset_stats();
+    Calculator calc(EvalMode::bytecode);
+    calc.eval_line("1 + 2 * 3");
+    CHECK(collect_stats().phases[0].count() == 0);
+
+    // every line timed
+    enable_stats(true, 1);
+    calc.eval_line("1 + 2 * 3");
+    calc.eval_line("");
+    calc.eval_line("(1 +");
+    // on another thread that exits before the stats are collected
+    thread other([]() {
+        Calculator calc;
+        calc.eval_line("-(4 - 1) / 2");
+    });
+    other.join();
+    enable_stats(false);
+
+    RuntimeStats stats = collect_stats();
+    // the blank line is tokenized too, the unfinished one is not evaluated
+    CHECK(stats.phases[static_cast<size_t>(Phase::tokenize)].count() == 4);
+    CHECK(stats.phases[static_cast<size_t>(Phase::parse)].count() == 2);
+    CHECK(stats.phases[static_cast<size_t>(Phase::evaluate)].count() == 2);
+    // the bytecode evaluator folds the constants with the operators
+    CHECK(stats.op_calls[static_cast<size_t>(OpCode::ADD)].get() == 1);
+    CHECK(stats.op_calls[static_cast<size_t>(OpCode::MULT)].get() == 1);
+    CHECK(stats.op_calls[static_cast<size_t>(OpCode::NEG)].get() == 1);
+    CHECK(stats.op_calls[static_cast<size_t>(OpCode::SUB)].get() == 1);
+    CHECK(stats.op_calls[static_cast<size_t>(OpCode::DIV)].get() == 1);
+
+    string text = repr_stats(stats);
+    CHECK(text.find("evaluate            2") != string::npos);
+    CHECK(text.find("MULT                1\n") != string::npos);
+
+    reset_stats();
+    CHECK(collect_stats().phases[0].count() == 0);
+    CHECK(collect_stats().op_calls[static_cast<size_t>(OpCode::ADD)].get() == 0);
+
+    // one line in 4 timed, all counted
+    enable_stats(true, 4);
+    for (int i = 0; i < 20; i++) {
+        calc.eval_line("1 + 2");
+    }
+    enable_stats(false);
+    stats = collect_stats();
+    CHECK(stats.phases[static_cast<size_t>(Phase::evaluate)].count() == 5);
+    CHECK(stats.op_calls[static_cast<size_t>(OpCode::ADD)].get() == 20);
+    CHECK(repr_stats(stats).find("1 in 4 lines") != string::npos);
+    reset_stats();
+}
@@ -10,7 +10,7 @@
 using namespace std;
 
 
-vector<Token::Ptr> get_tokens(const string &str) {
+vector<Token::Ptr> feed_tokens(const string &str) {
     Tokenizer tokenizer;
     for (char ch : str) {
         tokenizer.feed(ch);
@@ -21,6 +21,40 @@ vector<Token::Ptr> get_tokens(const string &str) {
     for (Token::Ptr tok = tokenizer.pop(); tok; tok = tokenizer.pop()) {
         ans.push_back(tok);
     }
+    return ans;
+}
+
+
+void check_same_tokens(const vector<Token::Ptr> &tokens1, const vector<Token::Ptr> &tokens2) {
+    REQUIRE(tokens1.size() == tokens2.size());
+    for (size_t i = 0; i < tokens1.size(); i++) {
+        CHECK(*tokens1[i] == *tokens2[i]);
+        CHECK(tokens1[i]->start == tokens2[i]->start);
+        CHECK(tokens1[i]->end == tokens2[i]->end);
+    }
+}
+
+
+// tokenize with both Tokenizer::feed() and tokenize(), they must agree
+vector<Token::Ptr> get_tokens(const string &str) {
+    vector<Token::Ptr> batch;
+    SourcePos batch_error;
+    try {
+        tokenize(str, batch);
+    } catch (const TokenizerError &exc) {
+        batch_error = exc.pos;
+        CHECK(batch_error.is_valid());
+    }
+
+    vector<Token::Ptr> ans;
+    try {
+        ans = feed_tokens(str);
+    } catch (const TokenizerError &exc) {
+        CHECK(exc.pos == batch_error);
+        throw;
+    }
+    CHECK_FALSE(batch_error.is_valid());
+    check_same_tokens(ans, batch);
 
     CHECK(ans.back()->type == TokenType::END);
     ans.pop_back();
@@ -89,9 +123,66 @@ TEST_CASE("Test Tokenizer single char token") {
 }
 
 
+TEST_CASE("Test Tokenizer name") {
+    vector<Token::Ptr> tokens = get_tokens("x+_a1*Rate2 2x");
+    REQUIRE(tokens.size() == 7);
+    CHECK(*tokens[0] == TokenName("x"));
+    CHECK(*tokens[2] == TokenName("_a1"));
+    CHECK(*tokens[4] == TokenName("Rate2"));
+    CHECK(*tokens[5] == TokenInt(2));
+    CHECK(*tokens[6] == TokenName("x"));
+    CHECK(*tokens[4] != TokenName("Rate"));
+
+    tokens = get_tokens("$0*$12 $3x");
+    REQUIRE(tokens.size() == 5);
+    CHECK(*tokens[0] == TokenName("$0"));
+    CHECK(*tokens[2] == TokenName("$12"));
+    CHECK(*tokens[3] == TokenName("$3"));
+    CHECK(*tokens[4] == TokenName("x"));
+
+    check_tokens_pos("ab+c", {
+        {{0, 0}, {0, 1}},
+        {{0, 2}, {0, 2}},
+        {{0, 3}, {0, 3}}
+    });
+}
+
+
 TEST_CASE("Test Tokenizer throw") {
     Tokenizer tokenizer;
-    CHECK_THROWS_AS(tokenizer.feed('x'), TokenizerError);
+    CHECK_THROWS_AS(tokenizer.feed('#'), const TokenizerError &);
+
+    vector<Token::Ptr> tokens;
+    CHECK_THROWS_AS(tokenize("#", tokens), const TokenizerError &);
+    for (string str : {"$", "$x", "1 + $ 2"}) {
+        CHECK_THROWS_AS(get_tokens(str), const TokenizerError &);
+    }
+    try {
+        tokenize("1 +\n 2 #", tokens);
+        FAIL("expect TokenizerError");
+    } catch (const TokenizerError &exc) {
+        CHECK(exc.pos == SourcePos(1, 3));
+    }
+}
+
+
+TEST_CASE("Test tokenize") {
+    string str = "1 + 2.5*(3e2 - .5E-1)\n\n  /4.\t123456789012 +1e+3\n";
+    vector<Token::Ptr> tokens;
+    tokenize(str, tokens);
+    check_same_tokens(tokens, feed_tokens(str));
+    CHECK(tokens.back()->start == SourcePos(3, 0));
+
+    // the buffer is reused
+    tokenize("", tokens);
+    REQUIRE(tokens.size() == 1);
+    CHECK(tokens[0]->type == TokenType::END);
+    CHECK(tokens[0]->start == SourcePos(0, 0));
+
+    str = string("1\0 2", 4);
+    tokenize(str, tokens);
+    check_same_tokens(tokens, feed_tokens(str));
+    CHECK(tokens.size() == 4);
 }
 
 
@@ -116,11 +207,27 @@ TEST_CASE("Test Tokenizer number") {
     CHECK(*get_tokens("1e50")[0] == F(1e50));
     CHECK(*get_tokens("1.e5")[0] == F(1e5));
     CHECK(*get_tokens("1e-1")[0] == F(1e-1));
+    CHECK(*get_tokens("9223372036854775807")[0] == I(9223372036854775807));
+    CHECK(*get_tokens("00009223372036854775808")[0]
+        == TokenBig(BigInt::from_digits("9223372036854775808")));
+    CHECK(*get_tokens("1e19")[0] == F(1e19));
+
+    CHECK_THROWS_AS(get_tokens("."), const TokenizerError &);
+    CHECK_THROWS_AS(get_tokens("1.2."), const TokenizerError &);
+    CHECK_THROWS_AS(get_tokens(".e5"), const TokenizerError &);
+    CHECK_THROWS_AS(get_tokens(".2."), const TokenizerError &);
+    CHECK_THROWS_AS(get_tokens("1e+"), const TokenizerError &);
+    CHECK_THROWS_AS(get_tokens("1e"), const TokenizerError &);
+}
+
 
-    CHECK_THROWS_AS(get_tokens("."), TokenizerError);
-    CHECK_THROWS_AS(get_tokens("1.2."), TokenizerError);
-    CHECK_THROWS_AS(get_tokens(".e5"), TokenizerError);
-    CHECK_THROWS_AS(get_tokens(".2."), TokenizerError);
-    CHECK_THROWS_AS(get_tokens("1e+"), TokenizerError);
-    CHECK_THROWS_AS(get_tokens("1e"), TokenizerError);
+TEST_CASE("Test Tokenizer number sequence") {
+    vector<Token::Ptr> tokens = get_tokens("123456.5e1 7 .25 8e-1\n9");
+    REQUIRE(tokens.size() == 5);
+    CHECK(*tokens[0] == F(1234565.0));
+    CHECK(*tokens[1] == I(7));
+    CHECK(*tokens[2] == F(.25));
+    CHECK(*tokens[3] == F(.8));
+    CHECK(*tokens[4] == I(9));
+    CHECK(tokens[4]->start == SourcePos(1, 0));
 }
@@ -1,204 +1,185 @@
-#include <cmath>
-#include <cstdint>
-#include <cstdlib>
-#include <limits>
+#include <cassert>
+#include <cctype>
 #include <memory>
 #include <string>
-#include <tuple>
+#include <vector>
 
+#include "number.h"
 #include "tokenizer.h"
 
 
-using std::atoi;
-using std::atoll;
-using std::pow;
 using std::make_shared;
-using std::numeric_limits;
 using std::string;
-using std::tie;
+using std::vector;
 
 
-tuple<Token::Ptr, bool, State *> State::keep_state() {
-    return make_tuple(Token::Ptr(), true, this);
+static inline bool is_digit(char ch) {
+    return ch >= '0' && ch <= '9';
 }
 
 
-tuple<Token::Ptr, bool, State*> InitState::feed(char ch) {
-#define SINGLE_CHAR(tok_ch, tok_type) \
-    else if (ch == tok_ch) { \
-        Token::Ptr tok = make_shared<Token>(TokenType::tok_type); \
-        return make_tuple(tok, true, this); \
-    }
+static inline bool is_name_start(char ch) {
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_';
+}
+
+
+static inline bool is_name_char(char ch) {
+    return is_name_start(ch) || is_digit(ch);
+}
 
-    if (ch == '\0') {
-        Token::Ptr tok = make_shared<Token>(TokenType::END);
-        return make_tuple(tok, true, this);
-    } else if (isspace(ch)) {
-        return this->keep_state();
+
+static inline const char *skip_name(const char *p, const char *end) {
+    while (p < end && is_name_char(*p)) {
+        p++;
     }
-    SINGLE_CHAR('+', PLUS)
-    SINGLE_CHAR('-', MINUS)
-    SINGLE_CHAR('*', MULT)
-    SINGLE_CHAR('/', DIV)
-    SINGLE_CHAR('(', LPAR)
-    SINGLE_CHAR(')', RPAR)
-    else if (isdigit(ch) || ch == '.') {
-        return make_tuple(Token::Ptr(), false, new NumberState);
-    } else {
-        throw TokenizerError("Unknown char: " + string(1, ch));
+    return p;
+}
+
+
+static inline const char *skip_digits(const char *p, const char *end) {
+    while (p < end && is_digit(*p)) {
+        p++;
     }
+    return p;
+}
+
 
-#undef SINGLE_CHAR
+static TokenizerError unknown_char(char ch, const char *expect, const SourcePos &pos) {
+    return TokenizerError("Unknown char: " + string(1, ch) + expect, pos);
 }
 
 
-tuple<Token::Ptr, bool, State*> NumberState::feed(char ch) {
-    switch (this->state) {
-    case NumberSubState::init:
-        if (isdigit(ch)) {
-            this->int_digits.push_back(ch);
-            this->state = NumberSubState::int_digit;
-            return this->keep_state();
-        } else if (ch == '.') {
-            this->has_dot = true;
-            this->state = NumberSubState::leading_dot;
-            return this->keep_state();
-        } else {
-            throw TokenizerError("Unknown char: " + string(1, ch) + ", expect dot or digit");
+void Tokenizer::feed(char ch) {
+    this->prev_pos = this->cur_pos;
+    this->cur_pos.add_char(ch);
+
+    if (this->state == TokenizerState::name
+        || this->state == TokenizerState::column_start
+        || this->state == TokenizerState::column_digit)
+    {
+        if (this->feed_name(ch)) {
+            return;
         }
+        this->push_token(make_shared<TokenName>(this->text), this->prev_pos);
+        this->state = TokenizerState::init;
+    } else if (this->state != TokenizerState::init) {
+        if (this->feed_number(ch)) {
+            return;
+        }
+        // ch ends the number, it starts a new token
+        this->push_token(make_number(this->text), this->prev_pos);
+        this->state = TokenizerState::init;
+    }
+    this->feed_init(ch);
+}
+
+void Tokenizer::feed_init(char ch) {
+    switch (ch) {
+    case '\0':
+        this->start_pos = this->cur_pos;
+        this->push_token(make_shared<Token>(TokenType::END), this->cur_pos);
+        return;
+    case '+': case '-': case '*': case '/': case '(': case ')':
+        this->start_pos = this->cur_pos;
+        this->push_token(make_shared<Token>(static_cast<TokenType>(ch)), this->cur_pos);
+        return;
+    default:
         break;
-    case NumberSubState::int_digit:
-        if (isdigit(ch)) {
-            this->int_digits.push_back(ch);
-            return this->keep_state();
-        } else if (ch == '.') {
-            this->has_dot = true;
-            this->state = NumberSubState::dotted;
-            return this->keep_state();
+    }
+
+    if (isspace(ch)) {
+        return;
+    } else if (is_digit(ch) || ch == '.') {
+        this->start_pos = this->cur_pos;
+        this->text.clear();
+        this->text.push_back(ch);
+        this->state = ch == '.' ? TokenizerState::leading_dot : TokenizerState::int_digit;
+    } else if (is_name_start(ch) || ch == '$') {
+        this->start_pos = this->cur_pos;
+        this->text.clear();
+        this->text.push_back(ch);
+        this->state = ch == '$' ? TokenizerState::column_start : TokenizerState::name;
+    } else {
+        throw unknown_char(ch, "", this->cur_pos);
+    }
+}
+
+// return false if ch is not part of the number
+bool Tokenizer::feed_number(char ch) {
+    switch (this->state) {
+    case TokenizerState::int_digit:
+        if (ch == '.') {
+            this->state = TokenizerState::dotted;
         } else if (ch == 'e' || ch == 'E') {
-            this->state = NumberSubState::exp;
-            return this->keep_state();
-        } else {
-            return this->finish();
+            this->state = TokenizerState::exp;
+        } else if (!is_digit(ch)) {
+            return false;
         }
         break;
-    case NumberSubState::leading_dot:
-        if (isdigit(ch)) {
-            this->dot_digits.push_back(ch);
-            this->state = NumberSubState::dotted;
-            return this->keep_state();
-        } else {
-            throw TokenizerError("Unknown char: " + string(1, ch) + ", expect digit");
+    case TokenizerState::leading_dot:
+        if (!is_digit(ch)) {
+            throw unknown_char(ch, ", expect digit", this->cur_pos);
         }
+        this->state = TokenizerState::dotted;
         break;
-    case NumberSubState::dotted:
-        if (isdigit(ch)) {
-            this->dot_digits.push_back(ch);
-            return this->keep_state();
-        } else if (ch == 'e' || ch == 'E') {
-            this->state = NumberSubState::exp;
-            return this->keep_state();
-        } else {
-            return this->finish();
+    case TokenizerState::dotted:
+        if (ch == 'e' || ch == 'E') {
+            this->state = TokenizerState::exp;
+        } else if (!is_digit(ch)) {
+            return false;
         }
         break;
-    case NumberSubState::exp:
+    case TokenizerState::exp:
         if (ch == '+' || ch == '-') {
-            this->state = NumberSubState::exp_signed;
-            if (ch == '-') {
-                this->exp_sign = -1;
-            }
-            return this->keep_state();
-        } else if (isdigit(ch)) {
-            this->exp_digits.push_back(ch);
-            this->state = NumberSubState::exp_digit;
-            return this->keep_state();
+            this->state = TokenizerState::exp_signed;
+        } else if (is_digit(ch)) {
+            this->state = TokenizerState::exp_digit;
         } else {
-            throw TokenizerError("Unknown char: " + string(1, ch) + ", expect digit or sign");
+            throw unknown_char(ch, ", expect digit or sign", this->cur_pos);
         }
         break;
-    case NumberSubState::exp_signed:
-        if (isdigit(ch)) {
-            this->exp_digits.push_back(ch);
-            this->state = NumberSubState::exp_digit;
-            return this->keep_state();
-        } else {
-            throw TokenizerError("Unknown char: " + string(1, ch) + ", expect digit");
+    case TokenizerState::exp_signed:
+        if (!is_digit(ch)) {
+            throw unknown_char(ch, ", expect digit", this->cur_pos);
         }
+        this->state = TokenizerState::exp_digit;
         break;
-    case NumberSubState::exp_digit:
-        if (isdigit(ch)) {
-            this->exp_digits.push_back(ch);
-            return this->keep_state();
-        } else {
-            return this->finish();
+    case TokenizerState::exp_digit:
+        if (!is_digit(ch)) {
+            return false;
         }
         break;
-    }
-    assert(!"Unreachable");
-}
-
-
-tuple<Token::Ptr, bool, State *> NumberState::finish() {
-    int64_t iv = atoll(this->int_digits.data());
-    double dv = iv;
-
-    double div = 10;
-    for (char ch : this->dot_digits) {
-        dv += (ch - '0') / div;
-        div *= 10;
-    }
-
-    if (!this->exp_digits.empty()) {
-        int exp = atoi(this->exp_digits.data()) * this->exp_sign;
-        dv *= pow(10, exp);
-        iv *= pow(10, exp);
-    }
-
-    Token::Ptr tok;
-    if (!this->has_dot && this->exp_sign > 0 && numeric_limits<int64_t>::max() > dv) {
-        tok = make_shared<TokenInt>(iv);
-    } else {
-        tok = make_shared<TokenFloat>(dv);
+    case TokenizerState::init:
+    case TokenizerState::name:
+    case TokenizerState::column_start:
+    case TokenizerState::column_digit:
+        assert(!"Unreachable");
     }
 
-    return make_tuple(tok, false, new InitState);
+    this->text.push_back(ch);
+    return true;
 }
 
-
-void Tokenizer::feed(char ch) {
-    Token::Ptr tok;
-    bool eaten = false;
-    State *new_state;
-
-    this->prev_pos = this->cur_pos;
-    this->cur_pos.add_char(ch);
-
-    while (!eaten) {
-        tie(tok, eaten, new_state) = this->state->feed(ch);
-        if (!this->start_pos.is_valid()) {
-            // ch got eaten by non-init state
-            if ((eaten && !dynamic_cast<InitState *>(this->state.get()))
-                || tok) // or single char token
-            {
-                this->start_pos = this->cur_pos;
-            }
-        }
-
-        if (tok) {
-            assert(this->start_pos.is_valid());
-            tok->start = this->start_pos;
-            if (eaten) {
-                tok->end = this->cur_pos;
-            } else {
-                tok->end = this->prev_pos;
-            }
-            this->start_pos = SourcePos();  // invalidate start_pos
-            this->tokens.push(tok);
+// return false if ch is not part of the name or column placeholder
+bool Tokenizer::feed_name(char ch) {
+    if (this->state == TokenizerState::column_start) {
+        if (!is_digit(ch)) {
+            throw unknown_char(ch, ", expect digit", this->cur_pos);
         }
-
-        this->set_new_state(new_state);
+        this->state = TokenizerState::column_digit;
+    } else if (this->state == TokenizerState::column_digit ? !is_digit(ch) : !is_name_char(ch)) {
+        return false;
     }
+    this->text.push_back(ch);
+    return true;
+}
+
+void Tokenizer::push_token(const Token::Ptr &tok, const SourcePos &end) {
+    assert(this->start_pos.is_valid());
+    tok->start = this->start_pos;
+    tok->end = end;
+    this->start_pos = SourcePos();  // invalidate start_pos
+    this->tokens.push(tok);
 }
 
 Token::Ptr Tokenizer::pop() {
@@ -212,14 +193,101 @@ Token::Ptr Tokenizer::pop() {
 }
 
 void Tokenizer::reset() {
-    this->set_new_state(new InitState);
+    this->state = TokenizerState::init;
     this->start_pos = SourcePos();
     this->cur_pos = SourcePos();
     queue<Token::Ptr>().swap(this->tokens);
 }
 
-void Tokenizer::set_new_state(State *new_state) {
-    if (new_state != this->state.get()) {
-        this->state.reset(new_state);
+
+void tokenize(string_view input, vector<Token::Ptr> &tokens) {
+    tokens.clear();
+
+    const char *p = input.data();
+    const char *const end = p + input.size();
+    // position of *p, advanced the same way as SourcePos::add_char()
+    int lineno = 0;
+    int rowno = 0;
+
+    // the '\0' after the input ends it like Tokenizer::feed('\0')
+    auto peek = [&](const char *q) {
+        return q < end ? *q : '\0';
+    };
+
+    auto push = [&](Token::Ptr tok, int len) {
+        tok->start = SourcePos(lineno, rowno);
+        tok->end = SourcePos(lineno, rowno + len - 1);
+        tokens.push_back(tok);
+    };
+
+    while (true) {
+        char ch = peek(p);
+        switch (ch) {
+        case '\0':
+            push(make_shared<Token>(TokenType::END), 1);
+            if (p == end) {
+                return;
+            }
+            break;
+        case '+': case '-': case '*': case '/': case '(': case ')':
+            push(make_shared<Token>(static_cast<TokenType>(ch)), 1);
+            break;
+        case '\n':
+            p++;
+            lineno++;
+            rowno = 0;
+            continue;
+        default:
+            if (isspace(ch)) {
+                break;
+            } else if (is_name_start(ch) || ch == '$') {
+                const char *q = ch == '$' ? skip_digits(p + 1, end) : skip_name(p, end);
+                if (q == p + 1 && ch == '$') {
+                    throw unknown_char(peek(q), ", expect digit", SourcePos(lineno, rowno + 1));
+                }
+                int len = int(q - p);
+                push(make_shared<TokenName>(string(p, len)), len);
+                p = q;
+                rowno += len;
+                continue;
+            } else if (!is_digit(ch) && ch != '.') {
+                throw unknown_char(ch, "", SourcePos(lineno, rowno));
+            } else {
+                const char *q = p;
+                auto error_at = [&](const char *expect) {
+                    return unknown_char(peek(q), expect, SourcePos(lineno, rowno + int(q - p)));
+                };
+
+                q = skip_digits(q, end);
+                if (peek(q) == '.') {
+                    const char *dot = q++;
+                    q = skip_digits(q, end);
+                    if (dot == p && q == dot + 1) {
+                        throw error_at(", expect digit");
+                    }
+                }
+
+                if (peek(q) == 'e' || peek(q) == 'E') {
+                    q++;
+                    bool is_signed = peek(q) == '+' || peek(q) == '-';
+                    if (is_signed) {
+                        q++;
+                    }
+                    const char *exp_start = q;
+                    q = skip_digits(q, end);
+                    if (q == exp_start) {
+                        throw error_at(is_signed ? ", expect digit" : ", expect digit or sign");
+                    }
+                }
+
+                int len = int(q - p);
+                push(make_number(string_view(p, len)), len);
+                p = q;
+                rowno += len;
+                continue;
+            }
+        }
+        p++;
+        rowno++;
     }
 }
@@ -1,13 +1,11 @@
 #ifndef CALCXX_TOKENIZER_H
 #define CALCXX_TOKENIZER_H
 
-#include <cassert>
-#include <cctype>
-#include <cstdlib>
-#include <memory>
+#include <cstdint>
 #include <queue>
 #include <string>
-#include <tuple>
+#include <string_view>
+#include <vector>
 
 #include "exception.h"
 #include "sourcepos.h"
@@ -16,69 +14,59 @@
 
 
 using std::string;
-using std::tuple;
-using std::unique_ptr;
+using std::string_view;
 using std::queue;
+using std::vector;
 
 
-class State {
-public:
-    virtual tuple<Token::Ptr, bool, State*> feed(char ch) = 0;
-
-protected:
-    tuple<Token::Ptr, bool, State*> keep_state();
-};
-
-
-class InitState : public State {
-public:
-    virtual tuple<Token::Ptr, bool, State*> feed(char ch);
-};
-
-
-enum class NumberSubState {
+enum class TokenizerState : uint8_t {
     init,
+    // inside a number literal
     int_digit,
     dotted,
     leading_dot,
     exp,
     exp_signed,
     exp_digit,
+    // inside a name
+    name,
+    // inside a column placeholder, $ and digits
+    column_start,
+    column_digit,
 };
 
 
-class NumberState : public State {
-public:
-    virtual tuple<Token::Ptr, bool, State*> feed(char ch);
-
-private:
-    NumberSubState state = NumberSubState::init;
-    string int_digits;
-    string dot_digits;
-    string exp_digits;
-    int exp_sign = 1;
-    bool has_dot = false;
-
-    tuple<Token::Ptr, bool, State*> finish();
-};
-
-
+/*
+ * Streaming tokenizer, fed one char at a time.
+ * The state machine lives inline, feeding does not allocate except for the emitted tokens.
+ */
 class Tokenizer {
 public:
-    Tokenizer() : state(new InitState()) {}
     void feed(char ch);
     Token::Ptr pop();
     void reset();
 
 private:
-    unique_ptr<State> state;
+    TokenizerState state = TokenizerState::init;
+    string text;            // chars of the current number or name, reused between tokens
     queue<Token::Ptr> tokens;
     SourcePos start_pos = SourcePos();
     SourcePos prev_pos;
     SourcePos cur_pos = SourcePos();
 
-    void set_new_state(State *new_state);
+    void feed_init(char ch);
+    bool feed_number(char ch);
+    bool feed_name(char ch);
+    void push_token(const Token::Ptr &tok, const SourcePos &end);
 };
 
 
+/*
+ * Scan the whole input in one pass, replacing the content of tokens.
+ * Gives the same tokens and positions as a fresh Tokenizer fed with input and a final '\0',
+ * so the last token is always END.
+ */
+void tokenize(string_view input, vector<Token::Ptr> &tokens);
+
+
 #endif // CALCXX_TOKENIZER_H
@@ -4,11 +4,14 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 
+#include "bigint.h"
 #include "sourcepos.h"
 #include "utils.hpp"
 
 
+using std::move;
 using std::shared_ptr;
 using std::string;
 using std::to_string;
@@ -17,6 +20,8 @@ using std::to_string;
 enum class TokenType {
     INT = 'i',
     FLOAT = 'f',
+    BIG = 'b',      // an int literal too large for int64
+    NAME = 'n',
 
     PLUS = '+',
     MINUS = '-',
@@ -133,4 +138,56 @@ struct TokenFloat : Token {
 };
 
 
+struct TokenBig : Token {
+    BigInt value;
+
+    explicit TokenBig(BigInt value)
+        : Token(TokenType::BIG), value(move(value))
+    {}
+
+    virtual bool is_op() const {
+        return false;
+    }
+
+    virtual bool operator==(const Token &other) const {
+        return this->type == other.type
+            && this->value == static_cast<const TokenBig &>(other).value;
+    }
+
+    virtual string _token_name() const {
+        return "Big";
+    }
+
+    virtual string _repr_value() const {
+        return this->value.to_string();
+    }
+};
+
+
+struct TokenName : Token {
+    string name;
+
+    explicit TokenName(const string &name)
+        : Token(TokenType::NAME), name(name)
+    {}
+
+    virtual bool is_op() const {
+        return false;
+    }
+
+    virtual bool operator==(const Token &other) const {
+        return this->type == other.type
+            && this->name == static_cast<const TokenName &>(other).name;
+    }
+
+    virtual string _token_name() const {
+        return "Name";
+    }
+
+    virtual string _repr_value() const {
+        return this->name;
+    }
+};
+
+
 #endif //CALCXX_TOKENS_H
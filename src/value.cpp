@@ -0,0 +1,60 @@
+#include <atomic>
+#include <cassert>
+#include <utility>
+
+#include "value.h"
+
+
+using std::atomic;
+using std::memory_order_acq_rel;
+using std::memory_order_relaxed;
+using std::move;
+
+
+struct BigBox {
+    atomic<size_t> refs;
+    BigInt value;
+
+    explicit BigBox(BigInt &&value) : refs(1), value(move(value)) {}
+};
+
+
+Value Value::of_big(BigInt &&v) {
+    if (v.fits_int64()) {
+        return Value::of_int(v.to_int64());
+    }
+    Value ans;
+    ans.type = ValueType::BIG;
+    ans.big = new BigBox(move(v));
+    return ans;
+}
+
+
+const BigInt &Value::big_value() const {
+    assert(this->type == ValueType::BIG);
+    return this->big->value;
+}
+
+
+void Value::retain() const {
+    this->big->refs.fetch_add(1, memory_order_relaxed);
+}
+
+
+void Value::release() {
+    if (this->big->refs.fetch_sub(1, memory_order_acq_rel) == 1) {
+        delete this->big;
+    }
+}
+
+
+Value token_to_value(const Token &tok) {
+    if (tok.type == TokenType::INT) {
+        return Value::of_int(static_cast<const TokenInt &>(tok).value);
+    } else if (tok.type == TokenType::BIG) {
+        return Value::of_big(BigInt(static_cast<const TokenBig &>(tok).value));
+    } else {
+        assert(tok.type == TokenType::FLOAT);
+        return Value::of_float(static_cast<const TokenFloat &>(tok).value);
+    }
+}
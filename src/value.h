@@ -0,0 +1,148 @@
+#ifndef CALCXX_VALUE_H
+#define CALCXX_VALUE_H
+
+
+#include <cstdint>
+#include <string>
+
+#include "bigint.h"
+#include "tokens.h"
+#include "utils.hpp"
+
+
+using std::string;
+using std::to_string;
+
+
+enum class ValueType : uint8_t {
+    INT = static_cast<uint8_t>(TokenType::INT),
+    FLOAT = static_cast<uint8_t>(TokenType::FLOAT),
+    BIG = static_cast<uint8_t>(TokenType::BIG),
+};
+
+
+// a BigInt shared by the values holding it
+struct BigBox;
+
+
+/*
+ * An unboxed number used on the evaluation path.
+ * Tokens are only for lexing and diagnostics.
+ *
+ * Ints outside int64 are BIG and point to a shared immutable BigInt, only
+ * copying those touches a reference count. A value is BIG only if its int does
+ * not fit in int64, so every int has a single representation.
+ */
+struct Value {
+    ValueType type;
+    union {
+        int64_t ival;
+        double fval;
+        BigBox *big;
+    };
+
+    Value() : type(ValueType::INT), ival(0) {}
+
+    Value(const Value &other) : type(other.type), ival(other.ival) {
+        if (this->type == ValueType::BIG) {
+            this->retain();
+        }
+    }
+
+    Value(Value &&other) noexcept : type(other.type), ival(other.ival) {
+        other.type = ValueType::INT;
+    }
+
+    ~Value() {
+        if (this->type == ValueType::BIG) {
+            this->release();
+        }
+    }
+
+    Value &operator=(const Value &other) {
+        if (other.type == ValueType::BIG) {
+            other.retain();
+        }
+        if (this->type == ValueType::BIG) {
+            this->release();
+        }
+        this->type = other.type;
+        this->ival = other.ival;
+        return *this;
+    }
+
+    Value &operator=(Value &&other) noexcept {
+        if (this != &other) {
+            if (this->type == ValueType::BIG) {
+                this->release();
+            }
+            this->type = other.type;
+            this->ival = other.ival;
+            other.type = ValueType::INT;
+        }
+        return *this;
+    }
+
+    static Value of_int(int64_t v) {
+        Value ans;
+        ans.ival = v;
+        return ans;
+    }
+
+    static Value of_float(double v) {
+        Value ans;
+        ans.type = ValueType::FLOAT;
+        ans.fval = v;
+        return ans;
+    }
+
+    // an INT if v fits in int64
+    static Value of_big(BigInt &&v);
+
+    bool is_int() const {
+        return this->type == ValueType::INT;
+    }
+
+    // the type must be BIG
+    const BigInt &big_value() const;
+
+    double to_double() const {
+        if (this->type == ValueType::BIG) {
+            return this->big_value().to_double();
+        }
+        return this->is_int() ? static_cast<double>(this->ival) : this->fval;
+    }
+
+    bool operator==(const Value &other) const {
+        if (this->type != other.type) {
+            return false;
+        }
+        if (this->type == ValueType::BIG) {
+            return this->big_value() == other.big_value();
+        }
+        return this->is_int() ? this->ival == other.ival : this->fval == other.fval;
+    }
+
+    bool operator!=(const Value &other) const {
+        return !(*this == other);
+    }
+
+private:
+    void retain() const;
+    void release();
+};
+
+
+REPR(Value) {
+    if (value.type == ValueType::BIG) {
+        return value.big_value().to_string();
+    }
+    return value.is_int() ? to_string(value.ival) : to_string(value.fval);
+}
+
+
+// tok must be an INT, FLOAT or BIG token
+Value token_to_value(const Token &tok);
+
+
+#endif //CALCXX_VALUE_H